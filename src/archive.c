@@ -0,0 +1,188 @@
+// The game and the headless programs share this module. The game opens 
+// the archive at startup, so that every loader reads its file from one 
+// mapping instead of opening and streaming files of its own.
+#include <stddef.h>
+#include <string.h>
+
+#include "archive.h"
+#include "mapping.h"
+
+#define ARCHIVE_FNV_OFFSET 0x811C9DC5UL
+#define ARCHIVE_FNV_PRIME 0x01000193UL
+
+static struct {
+    unsigned char const *bytes;
+    unsigned long size, entries;
+    void *view;
+} archive;
+
+unsigned long getInteger(unsigned char const *src, unsigned int bytes) {
+    unsigned long value = 0;
+    unsigned int i;
+    
+    for (i = 0; i < bytes; ++i) {
+        value |= (unsigned long) src[i] << 8*i;
+    }
+    return value;
+}
+
+void putInteger(unsigned char *dst, unsigned long value, unsigned int bytes) {
+    unsigned int i;
+    
+    for (i = 0; i < bytes; ++i) {
+        dst[i] = (unsigned char) (value >> 8*i & 0xFFU);
+    }
+    return;
+}
+
+// Compare the path of an entry with a path that may use backslashes.
+static int matchName(unsigned char const *name, char const *path) {
+    unsigned int i;
+    
+    for (i = 0; i < ARCHIVE_NAME_BYTES; ++i) {
+        char const c = path[i] == '\\' ? '/' : path[i];
+        
+        if ((char) name[i] != c) {
+            return 0;
+            
+        } else if (c == '\0') {
+            return 1;
+            
+        }
+    }
+    
+    return 0;
+}
+
+// Find the entry of an asset in the archive, or return a null pointer.
+static unsigned char const *findEntry(char const *path) {
+    unsigned long i;
+    
+    for (i = 0; i < archive.entries; ++i) {
+        unsigned char const *entry = archive.bytes + ARCHIVE_HEADER_BYTES
+            + i*ARCHIVE_ENTRY_BYTES;
+        
+        if (matchName(entry, path)) {
+            return entry;
+            
+        }
+    }
+    
+    return NULL;
+}
+
+int openArchive(char const *path) {
+    unsigned long i;
+    
+    closeArchive();
+    archive.view = mapFile(path, &archive.size);
+    if (archive.view == NULL) {
+        return 1;
+        
+    }
+    archive.bytes = archive.view;
+    
+    // Check every entry up front, so that lookups only need to check 
+    // the checksum.
+    if (archive.size < ARCHIVE_HEADER_BYTES
+            || memcmp(archive.bytes, ARCHIVE_SIGNATURE, 4) != 0) {
+        closeArchive();
+        return 1;
+        
+    }
+    
+    archive.entries = getInteger(archive.bytes + 4, 4);
+    if (archive.entries > (archive.size - ARCHIVE_HEADER_BYTES)
+            / ARCHIVE_ENTRY_BYTES) {
+        closeArchive();
+        return 1;
+        
+    }
+    
+    for (i = 0; i < archive.entries; ++i) {
+        unsigned char const *entry = archive.bytes + ARCHIVE_HEADER_BYTES
+            + i*ARCHIVE_ENTRY_BYTES;
+        unsigned long const offset =
+            getInteger(entry + ARCHIVE_NAME_BYTES, 4),
+            bytes = getInteger(entry + ARCHIVE_NAME_BYTES + 4U, 4);
+        
+        if (entry[ARCHIVE_NAME_BYTES - 1U] != '\0'
+                || offset > archive.size || bytes > archive.size - offset) {
+            closeArchive();
+            return 1;
+            
+        }
+    }
+    
+    return 0;
+}
+
+void closeArchive(void) {
+    if (archive.view != NULL) {
+        unmapFile(archive.view, archive.size);
+        
+    }
+    
+    memset(&archive, 0x00, sizeof archive);
+    return;
+}
+
+int openAsset(sAsset *a, char const *path) {
+    unsigned char const *entry = findEntry(path);
+    
+    a->view = NULL;
+    if (entry != NULL) {
+        a->bytes = archive.bytes + getInteger(entry + ARCHIVE_NAME_BYTES, 4);
+        a->size = getInteger(entry + ARCHIVE_NAME_BYTES + 4U, 4);
+        return hashAsset(a->bytes, a->size)
+            != getInteger(entry + ARCHIVE_NAME_BYTES + 8U, 4);
+        
+    }
+    
+    a->view = mapFile(path, &a->size);
+    a->bytes = a->view;
+    return a->view == NULL;
+}
+
+void closeAsset(sAsset *a) {
+    if (a->view != NULL) {
+        unmapFile(a->view, a->size);
+        
+    }
+    
+    a->view = NULL;
+    a->bytes = NULL;
+    return;
+}
+
+int stampAsset(char const *path, unsigned long *stamp) {
+    unsigned char const *entry = findEntry(path);
+    sAsset a;
+    
+    if (entry != NULL) {
+        *stamp = getInteger(entry + ARCHIVE_NAME_BYTES + 8U, 4);
+        return 0;
+        
+    }
+    
+    // The size and time of the last write of a file can stay the same 
+    // while its bytes change, so only its bytes tell.
+    if (openAsset(&a, path)) {
+        return 1;
+        
+    }
+    
+    *stamp = hashAsset(a.bytes, a.size);
+    closeAsset(&a);
+    return 0;
+}
+
+unsigned long hashAsset(unsigned char const *bytes, unsigned long size) {
+    unsigned long h = ARCHIVE_FNV_OFFSET, i;
+    
+    for (i = 0; i < size; ++i) {
+        h = ((h ^ bytes[i]) * ARCHIVE_FNV_PRIME) & 0xFFFFFFFFUL;
+    }
+    
+    return h;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef _HEADER_ARCHIVE
+
+// An archive bundles the files that the game loads into one file. It 
+// starts with a signature and the amount of entries as a 32-bit 
+// little-endian integer. A table of contents follows, with an entry 
+// per file. Each entry holds the path of the file from the working 
+// directory with forward slashes, padded with zero bytes, then the 
+// position of the file from the start of the archive, its amount of 
+// bytes and its checksum, as 32-bit little-endian integers.
+#define ARCHIVE_SIGNATURE "MIRA"
+#define ARCHIVE_HEADER_BYTES 8U
+#define ARCHIVE_NAME_BYTES 48U
+#define ARCHIVE_ENTRY_BYTES ~~(ARCHIVE_NAME_BYTES + 12U)
+
+// The bytes of an asset lie either in the archive or in a mapping of 
+// its own file. Only the latter has a view to release.
+typedef struct {
+    unsigned char const *bytes;
+    unsigned long size;
+    void *view;
+} sAsset;
+
+// Map an archive once for all the assets that the program opens 
+// afterwards. The function returns non-zero if there is no valid 
+// archive, in which case assets come from their own files.
+int openArchive(char const *path);
+void closeArchive(void);
+
+// Find the bytes of an asset by its path, first in the archive, then 
+// in a file of its own. Paths may use either kind of separator. The 
+// function returns non-zero if the asset is in neither place, or if 
+// its bytes in the archive do not match their checksum.
+int openAsset(sAsset *a, char const *path);
+void closeAsset(sAsset *a);
+
+// Find a stamp that changes whenever the bytes of an asset change. The 
+// stamp of an asset in the archive is the checksum of its entry, which 
+// needs no read of the asset. The stamp of an asset in a file of its 
+// own is the checksum of its bytes. The function returns non-zero if 
+// the asset is in neither place.
+int stampAsset(char const *path, unsigned long *stamp);
+
+// Compute the checksum of the bytes of an asset with the 32-bit FNV-1a 
+// hash.
+unsigned long hashAsset(unsigned char const *bytes, unsigned long size);
+
+// Read or write an integer of `bytes` bytes, least significant byte 
+// first. The archive and the other files of the game store their 
+// integers this way.
+unsigned long getInteger(unsigned char const *src, unsigned int bytes);
+void putInteger(unsigned char *dst, unsigned long value, unsigned int bytes);
+
+#define _HEADER_ARCHIVE
+#endif
\ No newline at end of file
@@ -7,7 +7,7 @@
 setlocal enabledelayedexpansion
 cls
 
-set translationunits=main.c init.c gfx.c logic.c
+set translationunits=main.c init.c gfx.c logic.c inputlog.c mapping.c archive.c decode.c
 set optimizationlevel=%1
 if [%optimizationlevel%]==[] (
     set /a optimizationlevel=0
@@ -0,0 +1,353 @@
+// Headless driver for the simulation. This program runs the game 
+// logic without any window, rendering or frame pacing. It feeds 
+// scripted inputs to the logic as fast as possible and reports the 
+// throughput of the simulation for each script, along with the hash 
+// of the state after the last tick. The program then compares reading 
+// the tiles of the level in their packed form with reading a copy that 
+// takes a byte per tile.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "global_dict.h"
+#include "logic.h"
+#include "archive.h"
+#include "timing.h"
+
+#define BENCH_DEFAULT_TICKS 200000UL
+
+// The tile benchmark reads every tile of the level this many times.
+#define BENCH_TILE_PASSES 1000U
+
+// A script holds a set of keys for some amount of ticks per step. The 
+// script loops back to its first step after its last step.
+typedef struct {
+    unsigned short ticks;
+    unsigned char keys;
+} sScriptStep;
+
+typedef struct {
+    char const *name;
+    sScriptStep const *steps;
+    unsigned int count;
+} sScenario;
+
+static sScriptStep const scriptIdle[] = {
+    { 1, 0 }
+};
+static sScriptStep const scriptWalk[] = {
+    { 1, KEY_RIGHT }
+};
+static sScriptStep const scriptRunJump[] = {
+    { 30, KEY_RIGHT|KEY_RUN },
+    { 20, KEY_RIGHT|KEY_RUN|KEY_JUMP }
+};
+static sScriptStep const scriptSlide[] = {
+    { 40, KEY_RIGHT|KEY_RUN },
+    { 24, KEY_RIGHT|KEY_SLIDE },
+    { 16, KEY_DOWN },
+    { 40, KEY_LEFT|KEY_RUN },
+    { 10, KEY_LEFT|KEY_JUMP }
+};
+
+#define SCENARIO(NAME, SCRIPT) { NAME, SCRIPT, ARRAY_ELEMENTS(SCRIPT) }
+static sScenario const scenarios[] = {
+    SCENARIO("idle", scriptIdle),
+    SCENARIO("walk", scriptWalk),
+    SCENARIO("run-jump", scriptRunJump),
+    SCENARIO("slide", scriptSlide)
+};
+
+// The checkpoint check saves checkpoints this many ticks apart.
+#define BENCH_CHECKPOINT_TICKS 500UL
+
+// The handle check keeps handles for this many ticks, which is long 
+// enough for actors to die and for new actors to take their slots.
+#define BENCH_HANDLE_TICKS 1000UL
+
+static void playScript(sContext *game, sScenario const *sc,
+    unsigned long ticks);
+static int checkCheckpoints(sContext *game);
+static int checkHandles(sContext *game);
+static int benchTiles(sLevel const *l);
+
+int main(int argc, char **argv) {
+    static sContext game;
+    unsigned long ticks;
+    unsigned int i;
+    int diverged = 0;
+    
+    ticks = argc > 1 ? strtoul(argv[1], NULL, 10) : BENCH_DEFAULT_TICKS;
+    if (ticks == 0) {
+        fprintf(stderr, "usage: %s [ticks]\n", argv[0]);
+        return 1;
+        
+    }
+    
+    memset(&game, 0x00, sizeof game);
+    openArchive(DIR_ARCHIVE);
+    if (loadMoldInfo(&game.scene.md, NULL, NULL) != MIRAGE_OK) {
+        fprintf(stderr, "Could not load the mold information.\n");
+        return 1;
+        
+    }
+    
+    if (initContext(&game.scene)) {
+        fprintf(stderr, "Could not load the initial stage.\n");
+        return 1;
+        
+    }
+    
+    printf("%-10s %10s %10s %12s %9s %7s %7s %10s\n", "scenario", "ticks",
+        "ms", "ticks/s", "ns/tick", "actors", "x", "hash");
+    for (i = 0; i < ARRAY_ELEMENTS(scenarios); ++i) {
+        sScenario const *sc = &scenarios[i];
+        unsigned long long start, elapsedNs;
+        
+        // Every scenario starts from the state right after loading the 
+        // level.
+        loadCheckpoint(&game.scene, 0);
+        memset(&game.input, 0x00, sizeof game.input);
+        
+        start = getNs();
+        playScript(&game, sc, ticks);
+        elapsedNs = getElapsedNs(start);
+        
+        printf("%-10s %10lu %10.2f %12.0f %9.1f %7u %7u   %08lx\n", sc->name,
+            ticks, (double) elapsedNs / 1e6,
+            (double) ticks * 1e9 / (double) elapsedNs,
+            (double) elapsedNs / (double) ticks,
+            game.scene.cast.live,
+            (unsigned int) game.scene.cast.x[ACTOR_PLAYER],
+            hashContext(&game));
+        
+        // The incremental hash must match a hash of the whole cast.
+        if (game.scene.cast.hash != hashCast(&game.scene.cast)) {
+            fprintf(stderr, "The hash of the %s scenario diverged.\n",
+                sc->name);
+            diverged = 1;
+            
+        }
+    }
+    
+    if (checkCheckpoints(&game) || checkHandles(&game)
+            || benchTiles(&game.scene.level)) {
+        diverged = 1;
+        
+    }
+    
+    freeCheckpoints(&game.scene.checkpoints);
+    freeRewind(&game.scene.rewind);
+    freeCast(&game.scene.cast);
+    freeLevel(&game.scene.level);
+    closeArchive();
+    return diverged;
+}
+
+// Feed the keys of a script to the game for some amount of ticks, from 
+// the first step of the script on.
+static void playScript(sContext *game, sScenario const *sc,
+        unsigned long ticks) {
+    unsigned long tick;
+    unsigned int step;
+    unsigned short stepTicks;
+    
+    for (tick = 0, step = 0, stepTicks = 0; tick < ticks; ++tick) {
+        if (stepTicks++ == sc->steps[step].ticks) {
+            stepTicks = 1;
+            step = (step + 1U) % sc->count;
+            
+        }
+        pressKeys(&game->input, sc->steps[step].keys);
+        updateContext(game);
+    }
+    
+    return;
+}
+
+// Save two checkpoints along the run-jump script, then load the first 
+// one and the initial one. Each load must bring back the hash of the 
+// cast at the time of its checkpoint, and the incremental hash must 
+// match a hash of the whole cast. The function returns non-zero 
+// otherwise, or if a checkpoint cannot be saved.
+static int checkCheckpoints(sContext *game) {
+    static sScenario const sc[] = {
+        SCENARIO("checkpoints", scriptRunJump)
+    };
+    unsigned long hashes[3];
+    unsigned int i;
+    
+    loadCheckpoint(&game->scene, 0);
+    memset(&game->input, 0x00, sizeof game->input);
+    hashes[0] = game->scene.cast.hash;
+    for (i = 1; i < ARRAY_ELEMENTS(hashes); ++i) {
+        playScript(game, sc, BENCH_CHECKPOINT_TICKS);
+        if (saveCheckpoint(&game->scene)) {
+            fprintf(stderr, "Could not save a checkpoint.\n");
+            return 1;
+            
+        }
+        hashes[i] = game->scene.cast.hash;
+    }
+    
+    // The loads also undo the ticks after the latest checkpoint.
+    for (i = 2; i-- > 0;) {
+        playScript(game, sc, BENCH_CHECKPOINT_TICKS);
+        loadCheckpoint(&game->scene, i);
+        if (game->scene.checkpoints.count != i + 1U
+                || game->scene.cast.hash != hashes[i]
+                || game->scene.cast.hash != hashCast(&game->scene.cast)) {
+            fprintf(stderr, "Loading checkpoint %u diverged.\n", i);
+            return 1;
+            
+        }
+    }
+    
+    return 0;
+}
+
+// Take a handle to every actor partway through the run-jump script, 
+// then play on. A handle must still find its actor while the actor 
+// lives, and find nothing once the actor died, even if another actor 
+// took its slot since. A handle to that other actor must find the 
+// slot. The function returns non-zero otherwise, if no actor took the 
+// slot of a dead actor, or if the handles do not fit in memory.
+static int checkHandles(sContext *game) {
+    static sScenario const sc[] = {
+        SCENARIO("handles", scriptRunJump)
+    };
+    sCast const *c = &game->scene.cast;
+    ACTOR_HANDLE *handles;
+    unsigned int slots, slot, reused = 0;
+    
+    loadCheckpoint(&game->scene, 0);
+    memset(&game->input, 0x00, sizeof game->input);
+    playScript(game, sc, BENCH_CHECKPOINT_TICKS);
+    slots = c->slots;
+    handles = malloc(slots * sizeof*handles);
+    if (handles == NULL) {
+        fprintf(stderr, "Could not keep the handles.\n");
+        return 1;
+        
+    }
+    
+    for (slot = 0; slot < slots; ++slot) {
+        handles[slot] = c->moldId[slot] == MOLD_NULL
+            ? ACTOR_HANDLE_NONE : getActorHandle(c, slot);
+    }
+    playScript(game, sc, BENCH_HANDLE_TICKS);
+    
+    for (slot = 0; slot < slots; ++slot) {
+        ACTOR_HANDLE const now = getActorHandle(c, slot);
+        
+        if (handles[slot] == ACTOR_HANDLE_NONE) {
+            continue;
+            
+        } else if (handles[slot] == now) {
+            if (findActorSlot(c, handles[slot]) == slot) {
+                continue;
+                
+            }
+            
+        } else if (findActorSlot(c, handles[slot]) == ACTOR_SLOT_NONE) {
+            if (c->moldId[slot] == MOLD_NULL) {
+                continue;
+                
+            }
+            
+            ++reused;
+            if (findActorSlot(c, now) == slot) {
+                continue;
+                
+            }
+            
+        }
+        
+        fprintf(stderr, "The handle to slot %u resolved wrongly.\n", slot);
+        free(handles);
+        return 1;
+    }
+    
+    free(handles);
+    if (reused == 0) {
+        fprintf(stderr, "No actor took the slot of a dead actor.\n");
+        return 1;
+        
+    }
+    
+    return 0;
+}
+
+// Read every tile of the level column by column, like the rendering 
+// does, once from the packed tiles and once from an expanded copy. The 
+// function returns non-zero if the layouts disagree, or if the copy 
+// does not fit in memory.
+static int benchTiles(sLevel const *l) {
+    unsigned long const tiles = (unsigned long) l->w * l->h;
+    unsigned long sums[2];
+    unsigned long long elapsedNs[2];
+    TILE *expanded;
+    unsigned int column, row, pass, layout;
+    
+    expanded = malloc((size_t) tiles * sizeof*expanded);
+    if (expanded == NULL) {
+        fprintf(stderr, "Could not expand the tiles.\n");
+        return 1;
+        
+    }
+    
+    for (column = 0; column < l->w; ++column) {
+        for (row = 0; row < l->h; ++row) {
+            expanded[column*l->h + row] = getTile(l, column, row);
+        }
+    }
+    
+    for (layout = 0; layout < ARRAY_ELEMENTS(sums); ++layout) {
+        unsigned long long const start = getNs();
+        unsigned long sum = 0;
+        
+        for (pass = 0; pass < BENCH_TILE_PASSES; ++pass) {
+            for (column = 0; column < l->w; ++column) {
+                TILE const *at = &expanded[column*l->h];
+                
+                if (layout == 0) {
+                    for (row = 0; row < l->h; ++row) {
+                        sum += (unsigned long) getTile(l, column, row);
+                    }
+                    
+                } else {
+                    for (row = 0; row < l->h; ++row) {
+                        sum += (unsigned long) at[row];
+                    }
+                    
+                }
+            }
+        }
+        elapsedNs[layout] = getElapsedNs(start);
+        sums[layout] = sum;
+    }
+    
+    printf("\n%-10s %10s %10s %12s %9s %15s %10s\n", "tiles", "bytes", "ms",
+        "tiles/s", "ns/tile", "", "sum");
+    for (layout = 0; layout < ARRAY_ELEMENTS(sums); ++layout) {
+        unsigned long long const reads = (unsigned long long) tiles
+            * BENCH_TILE_PASSES;
+        
+        printf("%-10s %10lu %10.2f %12.0f %9.3f %15s   %08lx\n",
+            layout == 0 ? "packed" : "expanded",
+            layout == 0 ? (tiles + 1U)/2U : tiles,
+            (double) elapsedNs[layout] / 1e6,
+            (double) reads * 1e9 / (double) elapsedNs[layout],
+            (double) elapsedNs[layout] / (double) reads, "", sums[layout]);
+    }
+    
+    free(expanded);
+    if (sums[0] != sums[1]) {
+        fprintf(stderr, "The packed and expanded tiles differ.\n");
+        return 1;
+        
+    }
+    
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,23 @@
+#!/bin/sh
+# This script compiles the headless simulation benchmark, the input log 
+# replayer, the playtest driver, the level converter, the spawn list 
+# compiler, the asset packer and the graphic decoder benchmark with GCC 
+# on platforms other than Windows. It interprets its first argument as 
+# the target level of optimisation, like the `b.bat` file. The 
+# programs must run from this directory to find the `user` and `enemy` 
+# folders, like the game.
+cd "$(dirname "$0")"
+
+optimizationlevel=${1:-2}
+
+flags="-Wall -Wextra -Werror=attributes -Werror=pointer-arith -Werror=pointer-sign -Werror=missing-parameter-type -Werror=vla -Werror=declaration-after-statement -Werror=multichar -Werror=old-style-declaration -Werror=cast-align -Werror=cast-qual -Werror=cast-function-type -Werror=disabled-optimization -Werror=format=2 -Werror=init-self -Werror=logical-op -Werror=missing-include-dirs -Werror=redundant-decls -Werror=shadow -Werror=undef -Werror=alloca -Werror=strict-aliasing=1 -Werror=arith-conversion -Werror=missing-prototypes -Werror=inline -Werror=strict-prototypes -Werror=main -Werror=enum-conversion -Werror=conversion -Werror=int-conversion -Werror=jump-misses-init -Werror=incompatible-pointer-types -Werror=implicit-function-declaration -Werror=overflow -std=gnu89 -fdiagnostics-show-option -fno-builtin -fno-asm -O$optimizationlevel -fmax-errors=5 -msse -msse2"
+
+gcc bench.c timing.c logic.c mapping.c archive.c -o bench $flags || exit 1
+gcc replay.c timing.c inputlog.c logic.c mapping.c archive.c -o replay $flags || exit 1
+gcc playtest.c timing.c env.c logic.c mapping.c archive.c -o playtest $flags || exit 1
+gcc convlevel.c logic.c mapping.c archive.c -o convlevel $flags || exit 1
+gcc convspawn.c logic.c mapping.c archive.c -o convspawn $flags || exit 1
+gcc packassets.c archive.c mapping.c -o packassets $flags || exit 1
+gcc benchgfx.c timing.c decode.c logic.c mapping.c archive.c -o benchgfx $flags || exit 1
+
+echo "Build completed. Run ./bench [ticks], ./replay [log], ./playtest [games] [ticks], ./convlevel [input] [output] [chunk columns], ./convspawn [input] [output], ./packassets [output] [files] or ./benchgfx [megabytes] from this directory."
@@ -0,0 +1,247 @@
+// Headless benchmark for the graphic decoder. This program decodes the 
+// tile atlas, the sprite of every mold and a few synthetic graphic 
+// files over and over, and reports the throughput of the decoder for 
+// each of them. The synthetic files stress the decoder with one pixel 
+// per byte, with long runs, and with a palette header per chunk. The 
+// program also feeds every file to the decoder in small pieces, and 
+// checks that it gets the same pixels.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "global_dict.h"
+#include "logic.h"
+#include "archive.h"
+#include "decode.h"
+#include "timing.h"
+
+// The program decodes each file until it touches about this many 
+// megabytes, counting both the file and its pixels.
+#define BENCHGFX_DEFAULT_MEGABYTES 256UL
+
+// The streaming check feeds this many bytes at a time to the decoder.
+#define BENCHGFX_PIECE_BYTES 128UL
+
+#define BENCHGFX_SYNTHETIC_PIXELS (1UL << 20)
+#define BENCHGFX_STREAMS ~~(1U + MOLDS + 3U)
+
+typedef struct {
+    char name[MOLD_NAME_CHARS + 1U];
+    sAsset file;
+    unsigned char *synthetic;
+    unsigned long pixels, stridePixels;
+} sStream;
+
+typedef struct {
+    sStream streams[BENCHGFX_STREAMS];
+    unsigned int count;
+} sStreamList;
+
+static int addMoldStream(sMold *dst, unsigned char moldId,
+    char const (*name)[MOLD_NAME_CHARS], void *ctx);
+static int addSynthetic(sStreamList *list, char const *name,
+    unsigned int runPixels, unsigned long stridePixels);
+static int benchStream(sStream const *s, unsigned long megabytes);
+
+int main(int argc, char **argv) {
+    static sMoldDirectory md;
+    static sStreamList list;
+    unsigned long megabytes;
+    unsigned int i;
+    int failed = 0;
+    
+    megabytes = argc > 1 ? strtoul(argv[1], NULL, 10)
+        : BENCHGFX_DEFAULT_MEGABYTES;
+    if (megabytes == 0) {
+        fprintf(stderr, "usage: %s [megabytes]\n", argv[0]);
+        return 1;
+        
+    }
+    
+    openArchive(DIR_ARCHIVE);
+    strcpy(list.streams[0].name, "atlas");
+    list.streams[0].pixels = ALL_TILE_PELS;
+    list.streams[0].stridePixels = GROUP_PELS;
+    if (openAsset(&list.streams[0].file, DIR_ATLAS)) {
+        closeAsset(&list.streams[0].file);
+        fprintf(stderr, "Could not open the tile atlas.\n");
+        return 1;
+        
+    }
+    list.count = 1;
+    
+    if (loadMoldInfo(&md, &addMoldStream, &list) != MIRAGE_OK) {
+        fprintf(stderr, "Could not load the sprites of the molds.\n");
+        failed = 1;
+        
+    } else if (addSynthetic(&list, "pixels", 1U, BENCHGFX_SYNTHETIC_PIXELS)
+            || addSynthetic(&list, "runs", GFX_CHUNK_PIXELS/2U,
+            BENCHGFX_SYNTHETIC_PIXELS)
+            || addSynthetic(&list, "palettes", GFX_CHUNK_PIXELS/2U,
+            GFX_CHUNK_PIXELS)) {
+        failed = 1;
+        
+    } else {
+        printf("%-10s %10s %10s %8s %10s %10s %12s %10s\n", "file", "bytes",
+            "pixels", "passes", "ms", "MB/s", "pixels/s", "hash");
+        for (i = 0; i < list.count && !failed; ++i) {
+            failed = benchStream(&list.streams[i], megabytes);
+        }
+        
+    }
+    
+    for (i = 0; i < list.count; ++i) {
+        closeAsset(&list.streams[i].file);
+        free(list.streams[i].synthetic);
+    }
+    closeArchive();
+    return failed;
+}
+
+static int addMoldStream(sMold *dst, unsigned char moldId,
+        char const (*name)[MOLD_NAME_CHARS], void *ctx) {
+    sStreamList *list = ctx;
+    sStream *s = &list->streams[list->count];
+    char path[sizeof DIR_SPRITE DIR_SEP EXTENSION_GFX + MOLD_NAME_CHARS];
+    
+    (void) moldId;
+    memcpy(s->name, *name, MOLD_NAME_CHARS);
+    s->name[MOLD_NAME_CHARS] = '\0';
+    s->pixels = (unsigned long) dst->w * dst->h * dst->frames;
+    s->stridePixels = s->pixels;
+    sprintf(path, "%s%s%s", DIR_SPRITE DIR_SEP, s->name, EXTENSION_GFX);
+    if (openAsset(&s->file, path)) {
+        closeAsset(&s->file);
+        fprintf(stderr, "Could not open %s.\n", path);
+        return 1;
+        
+    }
+    
+    ++list->count;
+    return 0;
+}
+
+// Build a graphic file with the most colours possible. Every chunk 
+// consists of runs of `runPixels` pixels, and a palette header 
+// precedes every `stridePixels` pixels. The function returns non-zero 
+// if the file does not fit in memory.
+static int addSynthetic(sStreamList *list, char const *name,
+        unsigned int runPixels, unsigned long stridePixels) {
+    sStream *s = &list->streams[list->count];
+    unsigned long const headerBytes = 1UL + (GFX_COLORS-1U)*3UL;
+    unsigned long pixel, bytes;
+    unsigned char *write;
+    
+    s->pixels = BENCHGFX_SYNTHETIC_PIXELS;
+    s->stridePixels = stridePixels;
+    bytes = (s->pixels/stridePixels) * headerBytes + s->pixels;
+    s->synthetic = malloc(bytes);
+    if (s->synthetic == NULL) {
+        fprintf(stderr, "Could not build the %s file.\n", name);
+        return 1;
+        
+    }
+    
+    for (write = s->synthetic, pixel = 0; pixel < s->pixels; ) {
+        unsigned char const color = (unsigned char)
+            ((pixel/runPixels) % GFX_COLORS << SHIFT_COLOR);
+        
+        if (pixel % stridePixels == 0) {
+            unsigned long i;
+            
+            *write++ = GFX_COLORS - 1U;
+            for (i = 1; i < headerBytes; ++i) {
+                *write++ = (unsigned char) (i*37UL + pixel/stridePixels);
+            }
+            
+        }
+        
+        // Short runs take a byte of their own. Longer runs fill the 
+        // chunk from both ends in pairs of bytes.
+        if (runPixels <= SINGLE_MASK_LENGTH) {
+            *write++ = (unsigned char) (color | runPixels);
+            pixel += runPixels;
+            
+        } else {
+            *write++ = (unsigned char) (color | MASK_THERE_IS_TAIL
+                | runPixels >> DOUBLE_HIGH_HEAD_SHIFT);
+            *write++ = (unsigned char) ((runPixels << DOUBLE_LOW_HEAD_SHIFT
+                & DOUBLE_MASK_HEAD_LENGTH) | runPixels);
+            pixel += 2U*runPixels;
+            
+        }
+    }
+    
+    strcpy(s->name, name);
+    s->file.bytes = s->synthetic;
+    s->file.size = (unsigned long) (write - s->synthetic);
+    s->file.view = NULL;
+    ++list->count;
+    return 0;
+}
+
+// Decode a file repeatedly, then once more in pieces. The function 
+// returns non-zero if the decoder rejects the file, or if both ways 
+// disagree.
+static int benchStream(sStream const *s, unsigned long megabytes) {
+    unsigned long const size = s->file.size,
+        pixelBytes = s->pixels * (unsigned long) sizeof(sPixel);
+    unsigned long passes, pass, offset;
+    unsigned long long start, elapsedNs;
+    sPixel *whole, *pieces;
+    sGfxDecoder d;
+    int failed = 0;
+    
+    passes = (megabytes << 20) / (size + pixelBytes);
+    if (passes == 0) {
+        passes = 1;
+        
+    }
+    
+    whole = calloc(s->pixels, sizeof*whole);
+    pieces = calloc(s->pixels, sizeof*pieces);
+    if (whole == NULL || pieces == NULL) {
+        free(whole);
+        free(pieces);
+        fprintf(stderr, "Could not allocate the pixels of %s.\n", s->name);
+        return 1;
+        
+    }
+    
+    start = getNs();
+    for (pass = 0; pass < passes && !failed; ++pass) {
+        failed = decodeGfx(whole, s->pixels, s->file.bytes, size,
+            s->stridePixels);
+    }
+    elapsedNs = getElapsedNs(start);
+    
+    initGfxDecoder(&d, pieces, s->pixels, s->stridePixels);
+    for (offset = 0; offset < size && !failed;
+            offset += BENCHGFX_PIECE_BYTES) {
+        failed = feedGfxDecoder(&d, s->file.bytes + offset,
+            size - offset < BENCHGFX_PIECE_BYTES ? size - offset
+            : BENCHGFX_PIECE_BYTES);
+    }
+    
+    if (failed) {
+        fprintf(stderr, "The decoder rejected %s.\n", s->name);
+        
+    } else if (memcmp(whole, pieces, pixelBytes) != 0) {
+        fprintf(stderr, "The decoding of %s in pieces differs.\n",
+            s->name);
+        failed = 1;
+        
+    } else {
+        printf("%-10s %10lu %10lu %8lu %10.2f %10.1f %12.0f   %08lx\n",
+            s->name, size, s->pixels, passes, (double) elapsedNs / 1e6,
+            (double) size * (double) passes * 1e3 / (double) elapsedNs,
+            (double) s->pixels * (double) passes * 1e9 / (double) elapsedNs,
+            hashAsset((unsigned char const*) whole, pixelBytes));
+        
+    }
+    
+    free(whole);
+    free(pieces);
+    return failed;
+}
\ No newline at end of file
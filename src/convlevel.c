@@ -0,0 +1,174 @@
+// Offline converter of level files. This program loads a level file 
+// of either version, like the game does, and writes it as a version 2 
+// file split into chunks of columns. Chunks use runs of tiles instead 
+// of packed tiles if the runs take fewer bytes. The program then loads 
+// the new file back and checks that it holds the same level.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "logic.h"
+#include "archive.h"
+
+// Sixteen columns of tiles span a chunk of 256 pixels.
+#define CONV_DEFAULT_CHUNK_COLUMNS 16UL
+
+static unsigned long encodeChunk(sLevel const *l, unsigned long column,
+    unsigned long columns, unsigned char *dst, unsigned long *encoding);
+static int compareLevels(sLevel const *a, sLevel const *b);
+
+int main(int argc, char **argv) {
+    sLevel in, out;
+    unsigned char header[LEVEL_V2_HEADER_BYTES], *entries, *chunk;
+    unsigned long chunkColumns, chunks, i, offset, runChunks = 0;
+    FILE *f;
+    int failed;
+    
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s input output [chunk columns]\n", argv[0]);
+        return 1;
+        
+    }
+    
+    chunkColumns = argc > 3 ? strtoul(argv[3], NULL, 10)
+        : CONV_DEFAULT_CHUNK_COLUMNS;
+    memset(&in, 0x00, sizeof in);
+    memset(&out, 0x00, sizeof out);
+    if (chunkColumns == 0 || loadLevel(&in, argv[1])) {
+        fprintf(stderr, "Could not load the level %s.\n", argv[1]);
+        return 1;
+        
+    }
+    
+    // A chunk of runs never takes more bytes than a tile per byte.
+    chunks = (in.w + chunkColumns-1U) / chunkColumns;
+    entries = malloc((size_t) chunks * LEVEL_V2_ENTRY_BYTES);
+    chunk = malloc((size_t) chunkColumns * in.h);
+    f = fopen(argv[2], "wb");
+    if (entries == NULL || chunk == NULL || f == NULL) {
+        fprintf(stderr, "Could not write the level %s.\n", argv[2]);
+        free(entries);
+        free(chunk);
+        freeLevel(&in);
+        return 1;
+        
+    }
+    
+    memcpy(header, LEVEL_V2_SIGNATURE, sizeof LEVEL_V2_SIGNATURE - 1U);
+    putInteger(header + 4, in.w, 4);
+    putInteger(header + 8, in.h, 4);
+    putInteger(header + 12, in.spawn.x/TILE_PELS, 4);
+    putInteger(header + 16, in.spawn.y/TILE_PELS, 4);
+    putInteger(header + 20, chunkColumns, 4);
+    putInteger(header + 24, chunks, 4);
+    
+    // Write the header and the index once the positions of the chunks 
+    // are known.
+    offset = LEVEL_V2_HEADER_BYTES + chunks*LEVEL_V2_ENTRY_BYTES;
+    failed = fseek(f, (long) offset, SEEK_SET) != 0;
+    for (i = 0; i < chunks && !failed; ++i) {
+        unsigned long const column = i*chunkColumns;
+        unsigned long encoding;
+        unsigned long const bytes = encodeChunk(&in, column,
+            in.w - column < chunkColumns ? in.w - column : chunkColumns,
+            chunk, &encoding);
+        
+        putInteger(entries + i*LEVEL_V2_ENTRY_BYTES, offset, 4);
+        putInteger(entries + i*LEVEL_V2_ENTRY_BYTES + 4U, bytes, 4);
+        putInteger(entries + i*LEVEL_V2_ENTRY_BYTES + 8U, encoding, 4);
+        failed = fwrite(chunk, bytes, 1, f) != 1;
+        offset += bytes;
+        runChunks += encoding == LEVEL_CHUNK_RUNS;
+    }
+    
+    failed = failed || fseek(f, 0, SEEK_SET) != 0
+        || fwrite(header, sizeof header, 1, f) != 1
+        || fwrite(entries, LEVEL_V2_ENTRY_BYTES, chunks, f) != chunks;
+    failed = fclose(f) != 0 || failed;
+    free(entries);
+    free(chunk);
+    if (failed) {
+        fprintf(stderr, "Could not write the level %s.\n", argv[2]);
+        freeLevel(&in);
+        return 1;
+        
+    }
+    
+    if (loadLevel(&out, argv[2]) || compareLevels(&in, &out)) {
+        fprintf(stderr, "The level %s does not match the level %s.\n",
+            argv[2], argv[1]);
+        freeLevel(&out);
+        freeLevel(&in);
+        return 1;
+        
+    }
+    
+    printf("%s: %ux%u tiles, %lu bytes, %lu chunks of %lu columns, "
+        "%lu of runs\n", argv[2], in.w, in.h, offset, chunks, chunkColumns,
+        runChunks);
+    freeLevel(&out);
+    freeLevel(&in);
+    return 0;
+}
+
+// Encode the tiles of some columns as runs, or as packed tiles if the 
+// runs take more bytes, and return the amount of bytes.
+static unsigned long encodeChunk(sLevel const *l, unsigned long column,
+        unsigned long columns, unsigned char *dst, unsigned long *encoding) {
+    unsigned long const tiles = columns*l->h, packed = (tiles + 1U)/2U;
+    unsigned long i, bytes = 0;
+    
+    for (i = 0; i < tiles;) {
+        TILE const t = getTile(l, column + i/l->h, i%l->h);
+        unsigned long run = 1;
+        
+        while (run < LEVEL_RUN_TILES_MAX && i + run < tiles
+                && getTile(l, column + (i+run)/l->h, (i+run)%l->h) == t) {
+            ++run;
+        }
+        dst[bytes++] = (unsigned char) ((run - 1U) << 4 | (unsigned long) t);
+        i += run;
+    }
+    
+    if (bytes < packed) {
+        *encoding = LEVEL_CHUNK_RUNS;
+        return bytes;
+        
+    }
+    
+    memset(dst, 0x00, packed);
+    for (i = 0; i < tiles; ++i) {
+        unsigned long const t = (unsigned long)
+            getTile(l, column + i/l->h, i%l->h);
+        
+        dst[i/2U] = (unsigned char) (dst[i/2U] | t << (~i%2U*4U));
+    }
+    
+    *encoding = LEVEL_CHUNK_PACKED;
+    return packed;
+}
+
+static int compareLevels(sLevel const *a, sLevel const *b) {
+    unsigned int column, row;
+    
+    if (a->w != b->w || a->h != b->h || a->spawn.x != b->spawn.x
+            || a->spawn.y != b->spawn.y) {
+        return 1;
+        
+    }
+    
+    for (column = 0; column < a->w; ++column) {
+        for (row = 0; row < a->h; ++row) {
+            if (getTile(a, column, row) != getTile(b, column, row)) {
+                return 1;
+                
+            }
+        }
+    }
+    
+    return memcmp(a->solid, b->solid, (size_t) a->w * a->solidStride
+        * sizeof*a->solid) != 0
+        || memcmp(a->clearLeft, b->clearLeft, 2U * (size_t) a->w * a->h
+        * sizeof*a->clearLeft) != 0;
+}
\ No newline at end of file
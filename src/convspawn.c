@@ -0,0 +1,132 @@
+// Offline compiler of spawn lists. This program parses the text form 
+// of a spawn list, like the game does, and writes it as a compiled 
+// spawn table that the game loads without parsing. The first entry 
+// stays first, since it places the player, and the other entries 
+// follow in increasing order of their horizontal coordinate. Entries 
+// at the same coordinate keep their order. The slots of the actors 
+// follow the order of the table, so the game then places the actors 
+// from left to right.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "logic.h"
+#include "archive.h"
+
+// Each entry remembers its place in the text, since the `qsort` 
+// function is not stable.
+typedef struct {
+    sActor actor;
+    unsigned long place;
+} sSpawnEntry;
+
+typedef struct {
+    sSpawnEntry *entries;
+    unsigned long count, capacity;
+} sSpawnList;
+
+static int addEntry(sActor const *a, void *ctx);
+static int compareEntries(void const *a, void const *b);
+
+int main(int argc, char **argv) {
+    sCoord const start = { SPAWN_COORD_START, SPAWN_COORD_START };
+    sSpawnList list;
+    unsigned char record[SPAWN_HEADER_BYTES];
+    unsigned long stamp, i;
+    FILE *f;
+    int failed;
+    
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s input output\n", argv[0]);
+        return 1;
+        
+    }
+    
+    memset(&list, 0x00, sizeof list);
+    if (stampAsset(argv[1], &stamp)
+            || parseSpawnText(argv[1], start, addEntry, &list)) {
+        fprintf(stderr, "Could not parse the spawn list %s.\n", argv[1]);
+        free(list.entries);
+        return 1;
+        
+    }
+    
+    if (list.count > 1) {
+        qsort(list.entries + 1, list.count - 1U, sizeof*list.entries,
+            compareEntries);
+        
+    }
+    
+    f = fopen(argv[2], "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Could not write the spawn table %s.\n", argv[2]);
+        free(list.entries);
+        return 1;
+        
+    }
+    
+    memcpy(record, SPAWN_SIGNATURE, 4);
+    putInteger(record + 4, list.count, 4);
+    putInteger(record + 8, stamp, 4);
+    failed = fwrite(record, SPAWN_HEADER_BYTES, 1, f) != 1;
+    for (i = 0; i < list.count && !failed; ++i) {
+        sActor const *a = &list.entries[i].actor;
+        
+        putInteger(record, a->pos.x, 2);
+        putInteger(record + 2, a->pos.y, 2);
+        record[4] = a->moldId;
+        record[5] = (unsigned char) a->health;
+        record[6] = record[7] = 0;
+        failed = fwrite(record, SPAWN_RECORD_BYTES, 1, f) != 1;
+    }
+    
+    failed = fclose(f) != 0 || failed;
+    free(list.entries);
+    if (failed) {
+        fprintf(stderr, "Could not write the spawn table %s.\n", argv[2]);
+        return 1;
+        
+    }
+    
+    printf("%s: %lu entries, %lu bytes\n", argv[2], list.count,
+        SPAWN_HEADER_BYTES + list.count*SPAWN_RECORD_BYTES);
+    return 0;
+}
+
+static int addEntry(sActor const *a, void *ctx) {
+    sSpawnList *list = ctx;
+    
+    if (list->count == list->capacity) {
+        unsigned long const capacity = list->capacity
+            ? 2U*list->capacity : 64U;
+        sSpawnEntry *entries = realloc(list->entries,
+            (size_t) capacity * sizeof*entries);
+        
+        if (entries == NULL) {
+            return 1;
+            
+        }
+        list->entries = entries;
+        list->capacity = capacity;
+        
+    }
+    
+    list->entries[list->count].actor = *a;
+    list->entries[list->count].place = list->count;
+    ++list->count;
+    return 0;
+}
+
+// Order entries by their horizontal coordinate, then by their place in 
+// the text.
+static int compareEntries(void const *a, void const *b) {
+    sSpawnEntry const *l = a, *r = b;
+    
+    if (l->actor.pos.x != r->actor.pos.x) {
+        return l->actor.pos.x < r->actor.pos.x ? -1 : 1;
+        
+    }
+    
+    return l->place < r->place ? -1 : l->place > r->place;
+}
\ No newline at end of file
@@ -0,0 +1,239 @@
+// The game and the headless programs share this module. It decodes the 
+// graphic files of the sprites and of the tile atlas into pixels.
+#include <string.h>
+
+#include "global.h"
+#include "decode.h"
+
+enum {
+    PROBING_COLORS,
+    PROBING_BLUE,
+    PROBING_GREEN,
+    PROBING_RED
+};
+
+// A vector store covers this many pixels.
+#define VECTOR_PIXELS 4U
+
+static int decodeBytes(sGfxDecoder *d, unsigned char const *src,
+    unsigned long size);
+static void fillRun(sPixel *chunk, unsigned int first, unsigned int count,
+    sPixel color);
+
+void initGfxDecoder(sGfxDecoder *d, sPixel *dst, unsigned long pixels,
+        unsigned long stridePixels) {
+    
+    // A colour index of zero represents a transparent pixel.
+    memset(&d->color[0], 0x00, sizeof d->color[0]);
+    
+    // Set all alpha values of other colours to their maximum.
+    memset(&d->color[1], 0xFF, sizeof d->color - sizeof d->color[0]);
+    
+    // The algorithm begins by parsing a palette header.
+    d->colors = 255;
+    d->colorIndex = 1;
+    d->header = PROBING_COLORS;
+    
+    d->chunk = dst;
+    d->head = dst;
+    d->tail = dst + GFX_CHUNK_PIXELS-1;
+    d->pixelsLeftInChunk = GFX_CHUNK_PIXELS;
+    d->chunks = pixels / GFX_CHUNK_PIXELS;
+    d->stridePixels = stridePixels;
+    d->strideLeft = stridePixels;
+    d->headPixels = 0;
+    d->thereIsTail = 0;
+    return;
+}
+
+// Work on a copy of the state. The pixels consist of bytes, which may 
+// alias anything, so every store to them would otherwise force the 
+// state back into memory.
+int feedGfxDecoder(sGfxDecoder *d, unsigned char const *src,
+        unsigned long size) {
+    sGfxDecoder state = *d;
+    int const failed = decodeBytes(&state, src, size);
+    
+    *d = state;
+    return failed;
+}
+
+static int decodeBytes(sGfxDecoder *d, unsigned char const *src,
+        unsigned long size) {
+    unsigned long byteIndex;
+    
+    // The palette header describes pixel colours as RGB24. This format 
+    // stores a pixel with three bytes. The algorithm relies on the size 
+    // of the file to determine when to end.
+    for (byteIndex = 0; byteIndex < size; ) {
+        unsigned char byte, tailPixels;
+        
+        if (d->pixelsLeftInChunk == 0) {
+            d->pixelsLeftInChunk = GFX_CHUNK_PIXELS;
+            d->chunk += GFX_CHUNK_PIXELS;
+            d->head = d->chunk;
+            d->tail = d->chunk + GFX_CHUNK_PIXELS-1;
+            d->strideLeft -= GFX_CHUNK_PIXELS;
+            --d->chunks;
+            
+            // Do not increment the byte index, as this phase 
+            // does not get information.
+            continue;
+            
+        } else if (d->strideLeft == 0) {
+            d->colorIndex = 1;
+            d->colors = 255;
+            d->header = PROBING_COLORS;
+            d->strideLeft = d->stridePixels;
+            continue;
+            
+        } else {
+            byte = src[byteIndex++];
+            
+        }
+        
+        // Allow one more color for capturing all colours in the 
+        // header.
+        if (d->colors) {
+            switch (d->header) {
+                case PROBING_COLORS: {
+                    if (byte >= GFX_COLORS) {
+                        return 1;
+                        
+                    }
+                    
+                    d->colors = byte;
+                    d->header = PROBING_BLUE;
+                    continue;
+                    
+                }
+                
+                case PROBING_BLUE: {
+                    d->color[d->colorIndex].b = byte;
+                    d->header = PROBING_GREEN;
+                    continue;
+                    
+                }
+                
+                case PROBING_GREEN: {
+                    d->color[d->colorIndex].g = byte;
+                    d->header = PROBING_RED;
+                    continue;
+                    
+                }
+                
+                default: {
+                    d->color[d->colorIndex].r = byte;
+                    d->header = PROBING_BLUE;
+                    ++d->colorIndex;
+                    --d->colors;
+                    continue;
+                    
+                }
+            }
+            
+        } else if (d->thereIsTail) {
+            d->headPixels = (unsigned char) ((d->headPixels
+                << DOUBLE_HIGH_HEAD_SHIFT)
+                | ((byte&DOUBLE_MASK_HEAD_LENGTH) >> DOUBLE_LOW_HEAD_SHIFT));
+            tailPixels = (unsigned char) ((byte&DOUBLE_MASK_TAIL_LENGTH)
+                >> DOUBLE_SHIFT_TAIL_LENGTH);
+            
+            // Both runs must fit in the current chunk, and the chunk 
+            // must fit in the destination.
+            if (d->chunks == 0 || tailPixels > d->pixelsLeftInChunk) {
+                return 1;
+                
+            }
+            
+            // Runs shorter than a vector take a pixel at a time. The 
+            // tail brush grows backwards, so a longer run ends at the 
+            // brush.
+            d->pixelsLeftInChunk = (unsigned char)
+                (d->pixelsLeftInChunk - tailPixels);
+            if (tailPixels < VECTOR_PIXELS) {
+                while (tailPixels--) {
+                    *d->tail-- = d->color[d->colorIndex];
+                }
+                
+            } else {
+                d->tail -= tailPixels;
+                fillRun(d->chunk, (unsigned int) (d->tail - d->chunk) + 1U,
+                    tailPixels, d->color[d->colorIndex]);
+                
+            }
+            
+            // The algorithm covered the tail portion of the 
+            // datum at this point.
+            d->thereIsTail = 0;
+            
+        } else {
+            d->colorIndex = (unsigned char) ((byte&MASK_COLOR) >> SHIFT_COLOR);
+            d->headPixels = (unsigned char) ((byte&SINGLE_MASK_LENGTH)
+                >> SINGLE_SHIFT_LENGTH);
+            d->thereIsTail = byte&MASK_THERE_IS_TAIL;
+            if (d->thereIsTail) {
+                continue;
+                
+            }
+            
+        }
+        
+        if (d->chunks == 0 || d->headPixels > d->pixelsLeftInChunk) {
+            return 1;
+            
+        }
+        
+        d->pixelsLeftInChunk = (unsigned char)
+            (d->pixelsLeftInChunk - d->headPixels);
+        if (d->headPixels < VECTOR_PIXELS) {
+            while (d->headPixels) {
+                *d->head++ = d->color[d->colorIndex];
+                --d->headPixels;
+            }
+            
+        } else {
+            fillRun(d->chunk, (unsigned int) (d->head - d->chunk),
+                d->headPixels, d->color[d->colorIndex]);
+            d->head += d->headPixels;
+            d->headPixels = 0;
+            
+        }
+    }
+    
+    return 0;
+}
+
+int decodeGfx(sPixel *dst, unsigned long pixels, unsigned char const *src,
+        unsigned long size, unsigned long stridePixels) {
+    sGfxDecoder d;
+    
+    initGfxDecoder(&d, dst, pixels, stridePixels);
+    return feedGfxDecoder(&d, src, size);
+}
+
+#include <emmintrin.h>
+
+// Fill `count` pixels of a chunk with one colour, from the pixel at 
+// `first`. The run must cover at least a vector. It starts and ends 
+// with a vector store each, which may overlap the stores in between. 
+// The stores in between start on a whole amount of vectors from the 
+// start of the chunk, so that they stay aligned when the chunk is.
+static void fillRun(sPixel *chunk, unsigned int first, unsigned int count,
+        sPixel color) {
+    unsigned int const end = first + count;
+    __m128i const wide = _mm_set1_epi32((int) ((unsigned long) color.b
+        | (unsigned long) color.g << 8 | (unsigned long) color.r << 16
+        | (unsigned long) color.a << 24));
+    unsigned int i;
+    
+    _mm_storeu_si128((__m128i*)&chunk[first], wide);
+    for (i = (first + VECTOR_PIXELS) & ~(VECTOR_PIXELS - 1U);
+            i + VECTOR_PIXELS <= end;
+            i += VECTOR_PIXELS) {
+        _mm_storeu_si128((__m128i*)&chunk[i], wide);
+    }
+    _mm_storeu_si128((__m128i*)&chunk[end - VECTOR_PIXELS], wide);
+    
+    return;
+}
\ No newline at end of file
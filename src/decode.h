@@ -0,0 +1,66 @@
+#ifndef _HEADER_DECODE
+
+// Graphic files describe their pixels in chunks of this many pixels. 
+// Every run of a colour fills the chunk either from its start or from 
+// its end.
+#define GFX_CHUNK_PIXELS 64U
+
+// A palette header holds at most this many colours. The colour index 
+// of zero is always transparent.
+#define GFX_COLORS 8U
+
+// A palette header starts with its amount of colours, then describes 
+// each colour with a blue, a green and a red byte. Every other byte 
+// starts a run with a colour index and a length. If the byte has a 
+// tail, a second byte extends the length of the run from the start of 
+// the chunk and gives the length of a run from the end of the chunk.
+#define MASK_THERE_IS_TAIL 0x10
+#define MASK_COLOR 0xE0
+#define SHIFT_COLOR 5
+
+#define SINGLE_MASK_LENGTH 0x0F
+#define SINGLE_SHIFT_LENGTH 0
+#define DOUBLE_HIGH_HEAD_SHIFT 2
+#define DOUBLE_LOW_HEAD_SHIFT 6
+#define DOUBLE_MASK_HEAD_LENGTH 0xC0
+#define DOUBLE_MASK_TAIL_LENGTH 0x3F
+#define DOUBLE_SHIFT_TAIL_LENGTH 0
+
+// The tile atlas repeats its palette header after every group of 
+// tiles.
+#define TILES_PER_GROUP 4U
+#define GROUP_PELS ~~(TILE_PELS*TILE_PELS*TILES_PER_GROUP)
+#define ALL_TILE_PELS ~~(TILE_PELS*TILE_PELS*UNIQUE_TILES)
+
+// The file may consist of multiple repetitions of headers and graphic 
+// body data. That is, the graphic can alter its own palette data after 
+// some offset. The decoder keeps all of its state in this structure, 
+// so that the bytes of a file can come in pieces of any size.
+typedef struct {
+    
+    // The brushes are responsible for pointing to the next pixel to 
+    // write over.
+    sPixel *chunk, *head, *tail;
+    unsigned long stridePixels, strideLeft, chunks;
+    unsigned char pixelsLeftInChunk, colorIndex, colors, header,
+        headPixels, thereIsTail;
+    sPixel color[GFX_COLORS];
+} sGfxDecoder;
+
+// Prepare to decode at most `pixels` pixels to `dst`. A palette header 
+// precedes every `stridePixels` pixels.
+void initGfxDecoder(sGfxDecoder *d, sPixel *dst, unsigned long pixels,
+    unsigned long stridePixels);
+
+// Decode the next `size` bytes of a graphic file. The function returns 
+// non-zero if the bytes describe more pixels than the destination can 
+// hold, or more colours than a palette can hold.
+int feedGfxDecoder(sGfxDecoder *d, unsigned char const *src,
+    unsigned long size);
+
+// Decode a whole graphic file in memory.
+int decodeGfx(sPixel *dst, unsigned long pixels, unsigned char const *src,
+    unsigned long size, unsigned long stridePixels);
+
+#define _HEADER_DECODE
+#endif
\ No newline at end of file
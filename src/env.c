@@ -0,0 +1,145 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "logic.h"
+#include "env.h"
+
+int initEnv(sEnv *e, unsigned int count) {
+    if (loadMoldInfo(&e->base.md, NULL, NULL) != MIRAGE_OK
+            || initContext(&e->base)) {
+        freeEnv(e);
+        return 1;
+        
+    }
+    
+    e->games = malloc((count ? count : 1U) * sizeof*e->games);
+    if (e->games == NULL) {
+        freeEnv(e);
+        return 1;
+        
+    }
+    
+    // Only count the games that are ready, such that freeing the 
+    // environment after a failure only frees these games.
+    for (e->count = 0; e->count < count; ++e->count) {
+        sContext *game = &e->games[e->count];
+        
+        if (cloneContext(&game->scene, &e->base)) {
+            ++e->count;
+            freeEnv(e);
+            return 1;
+            
+        }
+        memset(&game->input, 0x00, sizeof game->input);
+    }
+    
+    return 0;
+}
+
+void resetEnv(sEnv *e, unsigned int game) {
+    loadCheckpoint(&e->games[game].scene, 0);
+    memset(&e->games[game].input, 0x00, sizeof e->games[game].input);
+    return;
+}
+
+void stepEnv(sEnv *e, unsigned int first, unsigned int last,
+        unsigned char const *keys, sObservation *obs) {
+    unsigned int i;
+    
+    for (i = first; i < last; ++i) {
+        pressKeys(&e->games[i].input, keys[i]);
+        updateContext(&e->games[i]);
+        observeEnv(e, i, &obs[i]);
+    }
+    
+    return;
+}
+
+#define ENV_DISTANCE(A, B) \
+    ((unsigned int) ((A) > (B) ? (A) - (B) : (B) - (A)))
+
+void observeEnv(sEnv *e, unsigned int game, sObservation *dst) {
+    sScene *s = &e->games[game].scene;
+    sLevel const *l = &s->level;
+    unsigned short const *slots;
+    unsigned int distances[ENV_NEARBY];
+    unsigned int x0, x1, column, row, found, i, j;
+    int left, bottom;
+    
+    getActor(&s->cast, ACTOR_PLAYER, &dst->player);
+    left = dst->player.pos.x / TILE_PELS - (int) ENV_VIEW_COLUMNS/2;
+    bottom = dst->player.pos.y / TILE_PELS - (int) ENV_VIEW_ROWS/2;
+    
+    for (column = 0; column < ENV_VIEW_COLUMNS; ++column) {
+        TILE *tiles = &dst->tiles[column*ENV_VIEW_ROWS];
+        int const x = left + (int) column;
+        
+        for (row = 0; row < ENV_VIEW_ROWS; ++row) {
+            int const y = bottom + (int) row;
+            
+            tiles[row] = x < 0 || x >= l->w || y < 0 || y >= l->h
+                ? 0 : getTile(l, (unsigned int) x, (unsigned int) y);
+        }
+    }
+    
+    // Keep the closest actors among the actors within the columns of 
+    // the window. Actors at the same distance keep the order of their 
+    // slots.
+    x0 = left > 0 ? (unsigned int) left * TILE_PELS : 0;
+    x1 = (unsigned int) (left + (int) ENV_VIEW_COLUMNS) * TILE_PELS;
+    found = findActors(s, x0, x1, &slots);
+    dst->nearbyCount = 0;
+    for (i = 0; i < found; ++i) {
+        unsigned int const slot = slots[i];
+        unsigned int distance;
+        
+        if (slot == ACTOR_PLAYER) {
+            continue;
+            
+        }
+        
+        distance = ENV_DISTANCE(s->cast.x[slot], dst->player.pos.x)
+            + ENV_DISTANCE(s->cast.y[slot], dst->player.pos.y);
+        for (j = dst->nearbyCount; j > 0 && distances[j-1U] > distance;
+                --j) {
+            if (j < ENV_NEARBY) {
+                distances[j] = distances[j-1U];
+                dst->nearby[j] = dst->nearby[j-1U];
+                
+            }
+        }
+        if (j < ENV_NEARBY) {
+            distances[j] = distance;
+            getActor(&s->cast, slot, &dst->nearby[j]);
+            if (dst->nearbyCount < ENV_NEARBY) {
+                ++dst->nearbyCount;
+                
+            }
+            
+        }
+    }
+    
+    return;
+}
+
+void freeEnv(sEnv *e) {
+    unsigned int i;
+    
+    for (i = 0; i < e->count; ++i) {
+        sScene *s = &e->games[i].scene;
+        
+        freeCheckpoints(&s->checkpoints);
+        freeRewind(&s->rewind);
+        freeCast(&s->cast);
+    }
+    free(e->games);
+    e->games = NULL;
+    e->count = 0;
+    
+    freeCheckpoints(&e->base.checkpoints);
+    freeRewind(&e->base.rewind);
+    freeCast(&e->base.cast);
+    freeLevel(&e->base.level);
+    return;
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef _HEADER_ENV
+
+// An environment steps many independent games at once, for automated 
+// playtesting and tuning. Every game starts from the same scene, and 
+// shares the molds and the level that the environment loads once. Each 
+// game has its own actors and its own inputs.
+typedef struct {
+    sScene base;
+    sContext *games;
+    unsigned int count;
+} sEnv;
+
+// An observation describes the surroundings of the player in a game. 
+// The nearby actors are the closest actors to the player, closest 
+// first. The window of tiles centers on the player and stores columns 
+// of tiles like the level, from the lowest tile up. Tiles outside of 
+// the level read as solid.
+#define ENV_NEARBY 8U
+#define ENV_VIEW_COLUMNS 16U
+#define ENV_VIEW_ROWS 12U
+typedef struct {
+    sActor player;
+    sActor nearby[ENV_NEARBY];
+    unsigned int nearbyCount;
+    TILE tiles[ENV_VIEW_COLUMNS*ENV_VIEW_ROWS];
+} sObservation;
+
+// Load the molds and the level, then set up `count` games. The function 
+// returns non-zero on failure. The environment must be zeroed before 
+// its first use.
+int initEnv(sEnv *e, unsigned int count);
+
+// Put a game back into its initial state.
+void resetEnv(sEnv *e, unsigned int game);
+
+// Advance the games from `first` up to, but excluding, `last` by one 
+// tick. The arrays of key sets and of observations have one element 
+// per game of the environment. Calls over ranges of games that do not 
+// overlap share no data that changes, so worker threads can step 
+// different ranges at the same time.
+void stepEnv(sEnv *e, unsigned int first, unsigned int last,
+    unsigned char const *keys, sObservation *obs);
+void observeEnv(sEnv *e, unsigned int game, sObservation *dst);
+void freeEnv(sEnv *e);
+
+#define _HEADER_ENV
+#endif
\ No newline at end of file
@@ -34,425 +34,184 @@ HBITMAP allocGfx(HDC sourceDc, BITMAPINFO *bi, unsigned int w,
     return hb;
 }
 
-// XXX: Remove when debugging is over
 #include <stdio.h>
 
-#include <fileapi.h>
-#include <handleapi.h>
 #include <memoryapi.h>
 #include "global_dict.h"
+#include "logic.h"
+#include "archive.h"
+#include "mapping.h"
+#include "decode.h"
 
-static int loadMoldDirectory(sMoldDirectory *dstMold, sPixel **pelBuffer, 
-    HANDLE hMoldInfoFile, HDC dstMemDc, BITMAPINFO *bi);
+// The mold information parser calls back into the graphics loader 
+// for every mold. The loader shares one pixel buffer across all 
+// molds. This buffer grows to accommodate the largest sprite.
+typedef struct {
+    sPixel *buffer;
+    unsigned long maxBytes;
+    HDC dstMemDc;
+    BITMAPINFO *bi;
+} sSpriteLoader;
+
+static int loadMoldSprite(sMold *dstMold, unsigned char moldId,
+    char const (*name)[MOLD_NAME_CHARS], void *ctx);
 static int loadSprite(sMold *dstMold, sPixel *pelBuffer, 
-    char const (*name)[8], HDC dstMemDc, BITMAPINFO *bi);
-static int decodeGfx(sPixel *dst, HANDLE hf, unsigned long stridePixels);
+    char const (*name)[MOLD_NAME_CHARS], HDC dstMemDc, BITMAPINFO *bi);
+static void buildMasks(unsigned char *dst, sPixel const *pelBuffer,
+    unsigned int width, unsigned int height);
+static void *openSpriteCache(char const *path, unsigned long stamp,
+    sMold const *mold, unsigned long bytes);
+static int saveSpriteCache(char const *path, unsigned long stamp,
+    sMold const *mold, unsigned char const *image, unsigned long bytes);
 
 int initMoldDirectory(sMoldDirectory *dstMold, HDC dstMemDc, 
         BITMAPINFO *bi) {
-    HANDLE hMoldInfoFile;
-    sPixel *buffer;
-    int error;
-    
-    hMoldInfoFile = CreateFile(DIR_MOLDINFO, 
-        GENERIC_READ,
-        FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-        NULL,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL);
-    if (hMoldInfoFile == INVALID_HANDLE_VALUE) {
-        PANIC("The process could not find actor mold data. "
-            "Expected a file in \""DIR_MOLDINFO"\".", 
-            MIRAGE_NO_MOLDINFO);
-        return 1;
-        
-    }
-    
-    buffer = NULL;
-    error = loadMoldDirectory(dstMold, &buffer, hMoldInfoFile, dstMemDc, bi);
+    sSpriteLoader loader;
+    MirageError code;
     
-    // The `loadMoldDirectory` function call cannot close the file 
-    // containing mold information.
-    CloseHandle(hMoldInfoFile);
+    loader.buffer = NULL;
+    loader.maxBytes = 0;
+    loader.dstMemDc = dstMemDc;
+    loader.bi = bi;
+    code = loadMoldInfo(dstMold, &loadMoldSprite, &loader);
     
-    // The call to the `loadMoldDirectory` function is not responsible 
+    // The call to the `loadMoldInfo` function is not responsible 
     // for deallocating buffer graphic data.
-    if (!VirtualFree(buffer, 0, MEM_RELEASE)) {
+    if (loader.buffer != NULL
+            && !VirtualFree(loader.buffer, 0, MEM_RELEASE)) {
         PANIC("The process failed to free buffer memory for graphic data.",
             MIRAGE_HEAP_FREE_FAIL);
         return 1;
         
     }
     
-    if (error) {
+    switch (code) {
+        case MIRAGE_OK: {
+            return 0;
+            
+        }
         
-        // The call to the `loadMoldDirectory` function is responsible 
-        // for posting the quit message.
-        return 1;
+        case MIRAGE_NO_MOLDINFO: {
+            PANIC("The process could not find actor mold data. "
+                "Expected a file in \""DIR_MOLDINFO"\".",
+                MIRAGE_NO_MOLDINFO);
+            break;
+            
+        }
+        
+        case MIRAGE_INTERRUPT_MOLDINFO: {
+            PANIC("The process unexpectedly cannot read \""DIR_MOLDINFO"\".",
+                MIRAGE_INTERRUPT_MOLDINFO);
+            break;
+            
+        }
         
+        case MIRAGE_INVALID_MOLDINFO: {
+            PANIC("The mold information file \""DIR_MOLDINFO
+                "\" is invalid.", MIRAGE_INVALID_MOLDINFO);
+            break;
+            
+        }
+        
+        // The call to the `loadMoldSprite` function is responsible 
+        // for posting the quit message.
+        default: {
+            break;
+            
+        }
     }
     
-    return 0;
+    return 1;
 }
 
-#define CHUNK_PIXELS 64U
+// The rows of a monochrome mask must take a whole amount of 16-bit 
+// words.
+#define MASK_ROW_BYTES(W) ((((unsigned long) (W) + 15UL) / 16UL) * 2UL)
 
-static int loadMoldDirectory(sMoldDirectory *dstMold, sPixel **pelBuffer, 
-        HANDLE hMoldInfoFile, HDC dstMemDc, BITMAPINFO *bi) {
-    unsigned long maxPels, ioBytes;
-    char buffer[64];
-    struct {
-        char name[8];
-        unsigned char braces, moldIndex, characters;
-        char foundDatum;
-        unsigned short number;
-        enum {
-            MOLDINFO_MOLDS,
-            MOLDINFO_ENTRY,
-            MOLDINFO_NAME,
-            MOLDINFO_WIDTH,
-            MOLDINFO_HEIGHT,
-            MOLDINFO_SPEED,
-            MOLDINFO_ACCEL,
-            MOLDINFO_FRAMES,
-            MOLDINFO_DATUM
-        } search;
-    } state = { { 0 }, 0, 0, 0, 0, 0, MOLDINFO_MOLDS };
-    
-    maxPels = 0;
-    do {
-        unsigned int byteIndex;
+// A sprite cache stores a decoded sprite next to its source file. It 
+// starts with a signature, the stamp of the source file as a 32-bit 
+// little-endian integer, then the width, height and amount of frames 
+// of the mold it belongs to, and a padding byte. The pixels follow, 
+// then the right mask and the left mask.
+#define SPRITE_CACHE_SIGNATURE "MIRC"
+#define SPRITE_CACHE_HEADER_BYTES 12U
+
+static int loadMoldSprite(sMold *dstMold, unsigned char moldId,
+        char const (*name)[MOLD_NAME_CHARS], void *ctx) {
+    sSpriteLoader *loader = ctx;
+    unsigned long const pels = (unsigned long)
+        (dstMold->w * dstMold->h * dstMold->frames);
+    unsigned long bytes;
+    
+    // The amount of pixels must be a multiple of the chunk size.
+    if (pels==0 || pels%GFX_CHUNK_PIXELS!=0) {
+        PANIC("An invalid mold entry is in the mold information file.",
+            MIRAGE_INVALID_MOLDENTRY);
+        return 1;
         
-        if (!ReadFile(hMoldInfoFile, buffer, ARRAY_ELEMENTS(buffer), 
-                &ioBytes, NULL)) {
-            PANIC("The process unexpectedly cannot read \""DIR_MOLDINFO"\".", 
-                MIRAGE_INTERRUPT_MOLDINFO);
-            
-            // The caller function is responsible for closing the mold 
-            // information file.
-            break;
+    }
+    
+    // The mold with the index of two must be the flag.
+    if ((moldId == 2 && (dstMold->w != 252U || dstMold->h != 16U))
+            || (moldId != 2 && memcmp(name, "ningen", 6) == 0)) {
+        PANIC("damedayo!", MIRAGE_OK);
+        return 1;
+        
+    }
+    
+    // The buffer holds the pixels of the sprite, followed by both of 
+    // its masks, in the same layout as the sprite cache.
+    bytes = pels*sizeof*loader->buffer + 2UL*MASK_ROW_BYTES(dstMold->w)
+        * dstMold->h * dstMold->frames;
+    if (bytes > loader->maxBytes) {
+        sPixel *p = loader->buffer;
+        
+        // The process should not bother checking whether it freed 
+        // memory correctly or not.
+        if (p != NULL) {
+            VirtualFree(p, 0, MEM_RELEASE);
             
         }
         
-        for (byteIndex = 0; byteIndex < ioBytes; ++byteIndex) {
-            char const byte = buffer[byteIndex];
-            
-            switch (byte) {
-                case '{': {
-                    if (state.braces >= 2U) {
-                        break;
-                
-                case '}':
-                        // Assume that the scope level is non-zero.
-                        
-                        if (state.braces-- == 1) {
-                            unsigned char temp;
-                            
-                            if (state.moldIndex-- == 0) {
-                                
-                                // The process ignores any data 
-                                // following the last mold entry.
-                                return 0;
-                                
-                            }
-                            
-                            temp = state.moldIndex;
-                            
-                            // Wipe out all mold information before 
-                            // beginning to process the next mold 
-                            // entry.
-                            memset(&state, 0x00, sizeof state);
-                            state.moldIndex = temp;
-                            state.search = MOLDINFO_ENTRY;
-                            
-                        } else {
-                            static unsigned char const datum[] = {
-                                MOLDINFO_WIDTH,
-                                MOLDINFO_HEIGHT,
-                                MOLDINFO_FRAMES,
-                                MOLDINFO_NAME,
-                                MOLDINFO_SPEED,
-                                MOLDINFO_ACCEL
-                            };
-                            
-                            if (state.number < ARRAY_ELEMENTS(datum)) {
-                                state.search = datum[state.number];
-                                
-                            }
-                            
-                            state.number = 0U;
-                            state.foundDatum = 0;
-                            continue;
-                            
-                        }
-                        
-                    } else {
-                        state.search = MOLDINFO_DATUM;
-                        ++state.braces;
-                        
-                    }
-                }
-                // Fall-through
-                case '\n':
-                case '\t':
-                case '\r':
-                case ' ': {
-                    if (!state.foundDatum) {
-                        continue;
-                        
-                    } else {
-                        switch (state.search) {
-                            case MOLDINFO_MOLDS: {
-                                if (state.number == 0) {
-                                    
-                                    // Return because there are no 
-                                    // mold entries to parse.
-                                    return 0;
-                                    
-                                }
-                                
-                                state.moldIndex = (unsigned char) 
-                                    (state.number - 1U);
-                                dstMold->molds = (unsigned char) state.number;
-                                state.search = MOLDINFO_ENTRY;
-                                break;
-                                
-                            }
-                            
-                            case MOLDINFO_NAME: {
-                                unsigned long const pels = (unsigned long)
-                                    (dstMold->data[state.moldIndex].w
-                                    * dstMold->data[state.moldIndex].h
-                                    * dstMold->data[state.moldIndex].frames);
-                                
-                                // The amount of pixels must be a 
-                                // multiple of the chunk size.
-                                if (pels==0 || pels%CHUNK_PIXELS!=0) {
-                                    PANIC("An invalid mold entry is in "
-                                        "the mold information file.",
-                                        MIRAGE_INVALID_MOLDENTRY);
-                                    return 1;
-                                    
-                                }
-                                
-                                if (state.moldIndex != 2
-                                        && memcmp(&state.name, "ningen",
-                                            6) == 0) {
-                                    PANIC("damedayo!", MIRAGE_OK);
-                                    return 1;
-                                    
-                                }
-                                
-                                if (pels > maxPels) {
-                                    sPixel *p = *pelBuffer;
-                                    
-                                    // The process should not bother 
-                                    // checking whether it freed 
-                                    // memory correctly or not.
-                                    if (p != NULL) {
-                                        VirtualFree(p, 0, MEM_RELEASE);
-                                        
-                                    }
-                                    
-                                    maxPels = pels;
-                                    p = VirtualAlloc(NULL, 
-                                        (pels * sizeof*p), 
-                                        MEM_COMMIT, 
-                                        PAGE_READWRITE);
-                                    if (p == NULL) {
-                                        PANIC("The process failed to reserve "
-                                            "heap memory for buffering pixel "
-                                            "data.", 
-                                            MIRAGE_HEAP_ALLOC_FAIL);
-                                        return 1;
-                                        
-                                    }
-                                    
-                                    // Commit the changes to the 
-                                    // current allocation for storing 
-                                    // sprite pixel data.
-                                    *pelBuffer = p;
-                                    
-                                }
-                                
-                                if (loadSprite(
-                                        &dstMold->data[state.moldIndex], 
-                                        *pelBuffer, &state.name, dstMemDc, 
-                                        bi)) {
-                                    
-                                    // The call to the `loadSprite` 
-                                    // function is responsible for 
-                                    // posting the quit message.
-                                    return 1;
-                                    
-                                }
-                                
-                                break;
-                                
-                            }
-                            
-                            case MOLDINFO_WIDTH: {
-                                dstMold->data[state.moldIndex].w = 
-                                    (unsigned char) state.number;
-                                
-                                // The mold with the index of two must 
-                                // be the flag.
-                                if (state.moldIndex == 2
-                                        && state.number != 252U) {
-                                    PANIC("damedayo!", MIRAGE_OK);
-                                    return 1;
-                                    
-                                }
-                                break;
-                                
-                            }
-                            
-                            case MOLDINFO_HEIGHT: {
-                                dstMold->data[state.moldIndex].h = 
-                                    (unsigned char) state.number;
-                                
-                                // Ditto.
-                                if (state.moldIndex == 2
-                                        && state.number != 16U) {
-                                    PANIC("damedayo!", MIRAGE_OK);
-                                    return 1;
-                                    
-                                }
-                                break;
-                                
-                            }
-                            
-                            case MOLDINFO_SPEED: {
-                                dstMold->data[state.moldIndex]
-                                    .maxSpeed = (unsigned char) 
-                                    state.number;
-                                break;
-                                
-                            }
-                            
-                            case MOLDINFO_ACCEL: {
-                                dstMold->data[state.moldIndex]
-                                    .subAccel = (signed char) 
-                                    state.number;
-                                break;
-                                
-                            }
-                            
-                            case MOLDINFO_FRAMES: {
-                                dstMold->data[state.moldIndex].frames = 
-                                    (unsigned char) state.number;
-                                break;
-                                
-                            }
-                            
-                            case MOLDINFO_DATUM:
-                            case MOLDINFO_ENTRY:
-                            default: {
-                                break;
-                                
-                            }
-                        }
-                        
-                    }
-                    state.number = 0U;
-                    state.foundDatum = 0;
-                    continue;
-                    
-                }
-                
-                case '0':
-                case '1':
-                case '2':
-                case '3':
-                case '4':
-                case '5':
-                case '6':
-                case '7':
-                case '8':
-                case '9': {
-                    state.number = (unsigned short)
-                        (state.number*10U);
-                    state.number = (unsigned short)
-                        (state.number + (byte-'0'));
-                    state.foundDatum = 1;
-                    continue;
-                    
-                }
-                
-                case 'a': case 'A':
-                case 'b': case 'B':
-                case 'c': case 'C':
-                case 'd': case 'D':
-                case 'e': case 'E':
-                case 'f': case 'F':
-                case 'g': case 'G':
-                case 'h': case 'H':
-                case 'i': case 'I':
-                case 'j': case 'J':
-                case 'k': case 'K':
-                case 'l': case 'L':
-                case 'm': case 'M':
-                case 'n': case 'N':
-                case 'o': case 'O':
-                case 'p': case 'P':
-                case 'q': case 'Q':
-                case 'r': case 'R':
-                case 's': case 'S':
-                case 't': case 'T':
-                case 'u': case 'U':
-                case 'v': case 'V':
-                case 'w': case 'W':
-                case 'x': case 'X':
-                case 'y': case 'Y':
-                case 'z': case 'Z': 
-                case '_': {
-                    if (state.search!=MOLDINFO_NAME
-                            || state.characters
-                            >=ARRAY_ELEMENTS(state.name) - 1) {
-                        // Include the null terminal.
-                        
-                        break;
-                        
-                    }
-                    state.name[state.characters++] = byte;
-                    state.foundDatum = 1;
-                    continue;
-                    
-                }
-                
-                default:
-            }
-            
-            PANIC("The mold information file \""DIR_MOLDINFO
-                "\" is invalid.", MIRAGE_INVALID_MOLDINFO);
+        loader->buffer = NULL;
+        loader->maxBytes = bytes;
+        p = VirtualAlloc(NULL, bytes, MEM_COMMIT, PAGE_READWRITE);
+        if (p == NULL) {
+            PANIC("The process failed to reserve heap memory for buffering "
+                "pixel data.", MIRAGE_HEAP_ALLOC_FAIL);
             return 1;
             
         }
-    } while (ioBytes == sizeof buffer);
-    
-    if (state.moldIndex != 0) {
-        PANIC("Mismatch between amount of molds and entries in "
-            "\""DIR_MOLDINFO"\".", MIRAGE_INVALID_MOLDINFO);
-        return 1;
+        
+        // Commit the changes to the current allocation for storing 
+        // sprite pixel data.
+        loader->buffer = p;
         
     }
     
-    return 0;
+    // The call to the `loadSprite` function is responsible for posting 
+    // the quit message.
+    return loadSprite(dstMold, loader->buffer, name, loader->dstMemDc,
+        loader->bi);
 }
 
 static int loadSprite(sMold *dstMold, sPixel *pelBuffer, 
-        char const (*name)[8], HDC dstMemDc, BITMAPINFO *bi) {
-    HANDLE hGraphicFile;
+        char const (*name)[MOLD_NAME_CHARS], HDC dstMemDc, BITMAPINFO *bi) {
+    sAsset file;
     BITMAPINFOHEADER *bih = &bi->bmiHeader;
     signed long tempW, tempH;
+    unsigned char const *image;
+    void *cache;
+    unsigned long pixels, maskBytes, cacheBytes, stamp;
     char const *src;
     char *write;
     int error;
     unsigned int characters;
     char root[] = DIR_SPRITE, suffix[] = "\0\0\0\0\0\0\0\0\0\0\0\0";
-    char const extension[] = EXTENSION_GFX;
-    char dir[sizeof root + sizeof suffix + sizeof extension];
+    char const extension[] = EXTENSION_GFX,
+        cacheExtension[] = EXTENSION_SPRITE_CACHE;
+    char dir[sizeof root + sizeof suffix + sizeof extension],
+        cacheDir[sizeof root + sizeof suffix + sizeof cacheExtension];
     
     root[ARRAY_ELEMENTS(root) - 1] = '\\';
     
@@ -463,208 +222,307 @@ static int loadSprite(sMold *dstMold, sPixel *pelBuffer,
     }
     memcpy(dir, root, sizeof root);
     memcpy(dir + sizeof root, suffix, characters * sizeof*suffix);
+    memcpy(cacheDir, dir, sizeof root + characters*sizeof*suffix);
     memcpy(dir + sizeof root + characters*sizeof*suffix, extension, 
         sizeof extension);
+    memcpy(cacheDir + sizeof root + characters*sizeof*suffix,
+        cacheExtension, sizeof cacheExtension);
     
-    hGraphicFile = CreateFile(dir, 
-        GENERIC_READ,
-        FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-        NULL,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL);
-    
-    if (hGraphicFile == INVALID_HANDLE_VALUE) {
+    // The stamp of a source file in the archive comes from its entry, so 
+    // that such a sprite with a valid cache never reads its source file. 
+    // A loose source file is read and hashed whole.
+    if (stampAsset(dir, &stamp)) {
         PANIC("The process could not locate sprite data.",
             MIRAGE_NO_GFX_SPRITE);
         return 1;
         
     }
     
+    pixels = (unsigned long) dstMold->w * dstMold->h * dstMold->frames;
+    maskBytes = MASK_ROW_BYTES(dstMold->w) * dstMold->h * dstMold->frames;
+    cacheBytes = SPRITE_CACHE_HEADER_BYTES + pixels*sizeof*pelBuffer
+        + 2UL*maskBytes;
+    
+    // Decode the sprite only if no cache matches its source file and 
+    // mold dimensions.
+    cache = openSpriteCache(cacheDir, stamp, dstMold, cacheBytes);
+    if (cache != NULL) {
+        image = (unsigned char const*) cache + SPRITE_CACHE_HEADER_BYTES;
+        
+    } else {
+        if (openAsset(&file, dir)) {
+            closeAsset(&file);
+            PANIC("The process could not locate sprite data.",
+                MIRAGE_NO_GFX_SPRITE);
+            return 1;
+            
+        }
+        
+        error = decodeGfx(pelBuffer, pixels, file.bytes, file.size, pixels);
+        closeAsset(&file);
+        if (error) {
+            PANIC("The process failed to load sprite data.",
+                MIRAGE_LOAD_GFX_FAIL);
+            return 1;
+            
+        }
+        
+        image = (unsigned char const*) pelBuffer;
+        buildMasks((unsigned char*) (pelBuffer + pixels), pelBuffer,
+            dstMold->w, (unsigned int) dstMold->h * dstMold->frames);
+        
+        // The sprite loads the same way whether the cache can be 
+        // written or not.
+        saveSpriteCache(cacheDir, stamp, dstMold, image,
+            cacheBytes - SPRITE_CACHE_HEADER_BYTES);
+        
+    }
+    
     tempW = bih->biWidth;
     tempH = bih->biHeight;
     do {
-        unsigned long pixels;
+        sSprite s;
         
         bih->biWidth = dstMold->w;
         bih->biHeight = dstMold->h * dstMold->frames;
         
-        pixels = (unsigned long)(bih->biWidth * bih->biHeight);
-        if (decodeGfx(pelBuffer, hGraphicFile, pixels)) {
-            PANIC("The process failed to load sprite data.",
-                MIRAGE_LOAD_GFX_FAIL);
+        // Interpret as a bottom-up bitmap.
+        bih->biHeight = -bih->biHeight;
+        s.color = CreateDIBitmap(dstMemDc,
+            bih,
+            CBM_INIT,
+            image,
+            bi,
+            DIB_RGB_COLORS);
+        bih->biHeight = -bih->biHeight;
+        if (s.color == NULL) {
+            PANIC("The process failed to create a sprite graphic.",
+                MIRAGE_LOAD_SPRITE_FAIL);
             error = 1;
             break;
             
-        } else {
-            sSprite s;
-            char *p;
-            unsigned long byteIndex;
-            unsigned int bitIndex, rowBits, rowIndex, paddingBytesPerRow,
-                paddingBitsAtLastByte, rowPayloadBytes;
+        }
+        
+        s.maskRight = CreateBitmap((signed int)bih->biWidth,
+            (signed int)bih->biHeight, 1, 1,
+            image + pixels*sizeof*pelBuffer);
+        if (s.maskRight == NULL) {
+            PANIC("The process failed to load the right sprite mask data.",
+                MIRAGE_LOAD_MASK_RIGHT_FAIL);
             
-            // Interpret as a bottom-up bitmap.
-            bih->biHeight = -bih->biHeight;
-            s.color = CreateDIBitmap(dstMemDc, 
-                bih,
-                CBM_INIT,
-                pelBuffer,
-                bi,
-                DIB_RGB_COLORS);
-            bih->biHeight = -bih->biHeight;
-            if (s.color == NULL) {
-                PANIC("The process failed to create a sprite graphic.",
-                    MIRAGE_LOAD_SPRITE_FAIL);
-                error = 1;
-                break;
-                
-            }
+            // The window destruction procedure is responsible for 
+            // deallocating sprite bitmaps.
+            error = 1;
+            break;
             
-            p = (char*)pelBuffer;
+        }
+        
+        s.maskLeft = CreateBitmap((signed int)bih->biWidth,
+            (signed int)bih->biHeight, 1, 1,
+            image + pixels*sizeof*pelBuffer + maskBytes);
+        if (s.maskLeft == NULL) {
+            PANIC("The process failed to load the left sprite mask data.",
+                MIRAGE_LOAD_MASK_LEFT_FAIL);
             
-            // The amount of bits in each row must be a multiple of a 
-            // Sixteen. Sixteen is the amount of bits in one word.
-            rowBits = (((unsigned int)bih->biWidth+15U) / 16U) * 16U;
-            paddingBytesPerRow = (rowBits - (unsigned int)bih->biWidth) / 8;
+            // The window destruction procedure is responsible for 
+            // deallocating sprite bitmaps.
+            error = 1;
+            break;
             
-            // Assume that eight divides the total amount of pixels in 
-            // the source bitmap. This assumption does not matter here 
-            // since this total is a multiple of sixty-four.
-            for (rowIndex = 0, bitIndex = 0, byteIndex = 0; 
-                    rowIndex < (unsigned int)bih->biHeight; 
-                    ++rowIndex) {
-                unsigned int payloadBitIndex;
-                unsigned int const width = (unsigned int)bih->biWidth;
-                
-                for (payloadBitIndex = 0; 
-                        payloadBitIndex < width;) {
-                    signed int shift;
-                    char byte = 0x00;
-                    
-                    for (shift = 7; 
-                            shift >= 0 && payloadBitIndex < width; 
-                            --shift) {
-                        byte |= (char)((pelBuffer[bitIndex++].a>0) 
-                            << shift);
-                        ++payloadBitIndex;
-                    }
-                    p[byteIndex++] = byte;
-                }
-                
-                // Do not set values to the padding bits, since they 
-                // will not appear anyways.
-                byteIndex += paddingBytesPerRow;
-            }
+        }
+        
+        dstMold->s = s;
+        
+        error = 0;
+        
+    } while (0);
+    bih->biWidth = tempW;
+    bih->biHeight = tempH;
+    
+    if (cache != NULL) {
+        unmapFile(cache, cacheBytes);
+        
+    }
+    
+    return error;
+}
+
+// Build the right mask of a sprite at `dst` and its left mask right 
+// after it. The masks take the layout that the `CreateBitmap` function 
+// expects.
+static void buildMasks(unsigned char *dst, sPixel const *pelBuffer,
+        unsigned int width, unsigned int height) {
+    unsigned char *p = dst;
+    unsigned long byteIndex;
+    unsigned int bitIndex, rowBits, rowIndex, paddingBytesPerRow,
+        paddingBitsAtLastByte, rowPayloadBytes;
+    
+    // The amount of bits in each row must be a multiple of a 
+    // Sixteen. Sixteen is the amount of bits in one word.
+    rowBits = ((width+15U) / 16U) * 16U;
+    paddingBytesPerRow = (rowBits - width) / 8;
+    
+    // Assume that eight divides the total amount of pixels in 
+    // the source bitmap. This assumption does not matter here 
+    // since this total is a multiple of sixty-four.
+    for (rowIndex = 0, bitIndex = 0, byteIndex = 0;
+            rowIndex < height;
+            ++rowIndex) {
+        unsigned int payloadBitIndex;
+        
+        for (payloadBitIndex = 0;
+                payloadBitIndex < width;) {
+            signed int shift;
+            unsigned char byte = 0x00;
             
-            s.maskRight = CreateBitmap((signed int)bih->biWidth, 
-                (signed int)bih->biHeight, 1, 1, pelBuffer);
-            if (s.maskRight == NULL) {
-                PANIC("The process failed to load the right sprite mask data.",
-                    MIRAGE_LOAD_MASK_RIGHT_FAIL);
-                
-                // The window destruction procedure is responsible for 
-                // deallocating sprite bitmaps.
-                error = 1;
-                break;
-                
+            for (shift = 7;
+                    shift >= 0 && payloadBitIndex < width;
+                    --shift) {
+                byte |= (unsigned char)((pelBuffer[bitIndex++].a>0)
+                    << shift);
+                ++payloadBitIndex;
             }
+            p[byteIndex++] = byte;
+        }
+        
+        // Clear the padding bits, since the cache stores them.
+        memset(&p[byteIndex], 0x00, paddingBytesPerRow);
+        byteIndex += paddingBytesPerRow;
+    }
+    
+    // The left mask starts as a copy of the right mask.
+    memcpy(p + byteIndex, p, byteIndex);
+    p += byteIndex;
+    
+    rowPayloadBytes = (width+7U) / 8;
+    paddingBitsAtLastByte = (8U*rowPayloadBytes - width);
+    
+    for (rowIndex = 0, byteIndex = 0;
+            rowIndex < height;
+            ++rowIndex) {
+        unsigned int rowByteIndex, effectiveIndex;
+        unsigned char remainder;
+        
+        // Shift the entire row of bits to relocate the 
+        // padding at the opposite end.
+        for (rowByteIndex = 0, remainder = 0x00;
+                rowByteIndex < rowPayloadBytes;
+                ++rowByteIndex) {
+            unsigned char const byte =
+                p[effectiveIndex = byteIndex+rowByteIndex],
+                byteWithoutRemainder = (unsigned char) (byte
+                    >> paddingBitsAtLastByte);
             
-            rowPayloadBytes = ((unsigned int)bih->biWidth+7U) / 8;
-            paddingBitsAtLastByte = (8U*rowPayloadBytes 
-                - (unsigned int)bih->biWidth);
-            
-            for (rowIndex = 0, byteIndex = 0;
-                    rowIndex < (unsigned int) bih->biHeight;
-                    ++rowIndex) {
-                unsigned int rowByteIndex, effectiveIndex;
-                unsigned char remainder;
-                
-                // Shift the entire row of bits to relocate the 
-                // padding at the opposite end.
-                for (rowByteIndex = 0, remainder = 0x00; 
-                        rowByteIndex < rowPayloadBytes;
-                        ++rowByteIndex) {
-                    unsigned char const byte = (unsigned char) 
-                        p[effectiveIndex = byteIndex+rowByteIndex],
-                        byteWithoutRemainder = (unsigned char) (byte
-                            >> paddingBitsAtLastByte);
-                    
-                    p[effectiveIndex] = (char) (byteWithoutRemainder | (remainder 
-                        << (8-paddingBitsAtLastByte)));
-                    remainder = (unsigned char) (byte
-                        - (byteWithoutRemainder<<paddingBitsAtLastByte));
-                }
-                
-                // Mirror all bits within each byte making up the row.
-                for (rowByteIndex = 0; 
-                        rowByteIndex < rowPayloadBytes; 
-                        ++rowByteIndex) {
-                    signed int shift = 7;
-                    unsigned char mirrorByte = 0x00, 
-                        sourceByte = (unsigned char)
-                        p[effectiveIndex = byteIndex+rowByteIndex];
-                    
-                    while (shift--) {
-                        char const bit = sourceByte&1;
-                        
-                        mirrorByte = (unsigned char)(mirrorByte|bit);
-                        sourceByte >>= 1;
-                        mirrorByte = (unsigned char)(mirrorByte<<1);
-                    }
-                    mirrorByte = (unsigned char)(mirrorByte|sourceByte);
-                    p[effectiveIndex] = (char)mirrorByte;
-                }
-                
-                // Mirror all bytes in the row.
-                for (rowByteIndex = 0; 
-                        rowByteIndex < rowPayloadBytes/2U; 
-                        ++rowByteIndex) {
-                    char const byteHead = p[effectiveIndex = 
-                        byteIndex+rowByteIndex],
-                        byteTail = p[byteIndex + rowPayloadBytes 
-                        - rowByteIndex-1U];
-                    p[effectiveIndex] = (char) byteTail;
-                    p[byteIndex + rowPayloadBytes - rowByteIndex-1U] = (char) 
-                        byteHead;
-                    
-                }
-                
-                byteIndex += rowBits/8U;
-            }
+            p[effectiveIndex] = (unsigned char) (byteWithoutRemainder
+                | (remainder << (8-paddingBitsAtLastByte)));
+            remainder = (unsigned char) (byte
+                - (byteWithoutRemainder<<paddingBitsAtLastByte));
+        }
+        
+        // Mirror all bits within each byte making up the row.
+        for (rowByteIndex = 0;
+                rowByteIndex < rowPayloadBytes;
+                ++rowByteIndex) {
+            signed int shift = 7;
+            unsigned char mirrorByte = 0x00,
+                sourceByte = p[effectiveIndex = byteIndex+rowByteIndex];
             
-            s.maskLeft = CreateBitmap((signed int)bih->biWidth, 
-                (signed int)bih->biHeight, 1, 1, pelBuffer);
-            if (s.maskLeft == NULL) {
-                PANIC("The process failed to load the left sprite mask data.",
-                    MIRAGE_LOAD_MASK_LEFT_FAIL);
-                
-                // The window destruction procedure is responsible for 
-                // deallocating sprite bitmaps.
-                error = 1;
-                break;
+            while (shift--) {
+                unsigned char const bit = sourceByte&1;
                 
+                mirrorByte = (unsigned char)(mirrorByte|bit);
+                sourceByte >>= 1;
+                mirrorByte = (unsigned char)(mirrorByte<<1);
             }
-            
-            dstMold->s = s;
-            
-            error = 0;
+            mirrorByte = (unsigned char)(mirrorByte|sourceByte);
+            p[effectiveIndex] = mirrorByte;
+        }
+        
+        // Mirror all bytes in the row.
+        for (rowByteIndex = 0;
+                rowByteIndex < rowPayloadBytes/2U;
+                ++rowByteIndex) {
+            unsigned char const byteHead = p[effectiveIndex =
+                byteIndex+rowByteIndex],
+                byteTail = p[byteIndex + rowPayloadBytes
+                - rowByteIndex-1U];
+            p[effectiveIndex] = byteTail;
+            p[byteIndex + rowPayloadBytes - rowByteIndex-1U] = byteHead;
             
         }
-    } while (0);
-    bih->biWidth = tempW;
-    bih->biHeight = tempH;
+        
+        byteIndex += rowBits/8U;
+    }
     
-    CloseHandle(hGraphicFile);
-    return error;
+    return;
+}
+
+// Map the sprite cache at `path` if it holds `bytes` bytes and matches 
+// the stamp of the source file and the dimensions of the mold. The 
+// function returns a null pointer otherwise.
+static void *openSpriteCache(char const *path, unsigned long stamp,
+        sMold const *mold, unsigned long bytes) {
+    unsigned char const *header;
+    unsigned long size;
+    void *view;
+    
+    view = mapFile(path, &size);
+    if (view == NULL) {
+        return NULL;
+        
+    }
+    
+    header = view;
+    if (size != bytes
+            || memcmp(header, SPRITE_CACHE_SIGNATURE, 4) != 0
+            || getInteger(header + 4, 4) != stamp
+            || header[8] != mold->w || header[9] != mold->h
+            || header[10] != mold->frames) {
+        unmapFile(view, size);
+        return NULL;
+        
+    }
+    
+    return view;
 }
 
-#define TILES_PER_GROUP 4U
-#define GROUP_PELS ~~(TILE_PELS*TILE_PELS*TILES_PER_GROUP)
-#define ALL_TILE_PELS ~~(TILE_PELS*TILE_PELS*UNIQUE_TILES)
+// Write the decoded pixels and masks of a sprite to its cache. The 
+// function removes the cache and returns non-zero on failure.
+static int saveSpriteCache(char const *path, unsigned long stamp,
+        sMold const *mold, unsigned char const *image, unsigned long bytes) {
+    unsigned char header[SPRITE_CACHE_HEADER_BYTES];
+    FILE *f;
+    int failed;
+    
+    f = fopen(path, "wb");
+    if (f == NULL) {
+        return 1;
+        
+    }
+    
+    memcpy(header, SPRITE_CACHE_SIGNATURE, 4);
+    putInteger(header + 4, stamp, 4);
+    header[8] = mold->w;
+    header[9] = mold->h;
+    header[10] = mold->frames;
+    header[11] = 0x00;
+    failed = fwrite(header, sizeof header, 1, f) != 1
+        || fwrite(image, bytes, 1, f) != 1;
+    failed = fclose(f) != 0 || failed;
+    
+    // A partial cache would only fail its size check, but it should 
+    // not linger.
+    if (failed) {
+        remove(path);
+        
+    }
+    
+    return failed;
+}
 
 HBITMAP initAtlas(HDC dstMemDc, BITMAPINFO *bi) {
     HBITMAP hb;
-    HANDLE hf;
+    sAsset file;
     sPixel *pelBuffer;
     unsigned long bufferBytes = ALL_TILE_PELS 
         * (unsigned long) sizeof*pelBuffer;
@@ -677,14 +535,8 @@ HBITMAP initAtlas(HDC dstMemDc, BITMAPINFO *bi) {
         
     }
     
-    hf = CreateFile(DIR_ATLAS, 
-        GENERIC_READ,
-        FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,
-        NULL,
-        OPEN_EXISTING,
-        FILE_ATTRIBUTE_NORMAL,
-        NULL);
-    if (hf == INVALID_HANDLE_VALUE) {
+    if (openAsset(&file, DIR_ATLAS)) {
+        closeAsset(&file);
         PANIC("The process could not locate the tile atlas.",
             MIRAGE_NO_ATLAS);
         
@@ -695,7 +547,8 @@ HBITMAP initAtlas(HDC dstMemDc, BITMAPINFO *bi) {
         bi->bmiHeader.biWidth = TILE_PELS;
         bi->bmiHeader.biHeight = TILE_PELS*UNIQUE_TILES;
         
-        if (decodeGfx(pelBuffer, hf, GROUP_PELS)) {
+        if (decodeGfx(pelBuffer, ALL_TILE_PELS, file.bytes, file.size,
+                GROUP_PELS)) {
             PANIC("The process failed to decode the tile atlas graphic "
                 "data.", MIRAGE_LOAD_ATLAS_FAIL);
             
@@ -712,7 +565,7 @@ HBITMAP initAtlas(HDC dstMemDc, BITMAPINFO *bi) {
             bi->bmiHeader.biHeight = -bi->bmiHeader.biHeight;
             
         }
-        CloseHandle(hf);
+        closeAsset(&file);
         
         bi->bmiHeader.biWidth = tempWidth;
         bi->bmiHeader.biHeight = tempHeight;
@@ -720,196 +573,4 @@ HBITMAP initAtlas(HDC dstMemDc, BITMAPINFO *bi) {
     }
     
     return hb;
-}
-
-#define RGB24_PIXEL_BYTES 3
-
-#define MASK_THERE_IS_TAIL 0x10
-#define MASK_COLOR 0xE0
-#define SHIFT_COLOR 5
-
-#define SINGLE_MASK_LENGTH 0x0F
-#define SINGLE_SHIFT_LENGTH 0
-#define DOUBLE_HIGH_HEAD_SHIFT 2
-#define DOUBLE_LOW_HEAD_SHIFT 6
-#define DOUBLE_MASK_HEAD_LENGTH 0xC0
-#define DOUBLE_MASK_TAIL_LENGTH 0x3F
-#define DOUBLE_SHIFT_TAIL_LENGTH 0
-
-static int decodeGfx(sPixel *dst, HANDLE hf, unsigned long stridePixels) {
-    struct {
-        sPixel *head, *tail;
-    } brush;
-    unsigned long ioBytes;
-    
-    // The file may consist of multiple repetitions of headers and 
-    // graphic body data. That is, the graphic can alter its own 
-    // palette data after some offset. Reading bytes from a file may 
-    // load in palette header data after pixel data. As such, the 
-    // state of the decoder must persist across changes in palette.
-    struct {
-        unsigned char pixelsLeftInChunk, colorIndex;
-        char thereIsTail;
-        enum {
-            PROBING_COLORS,
-            PROBING_BLUE,
-            PROBING_GREEN,
-            PROBING_RED
-        } parsingHeader;
-        unsigned char colors;
-        struct {
-            unsigned char head, tail;
-            unsigned long left;
-        } pixels;
-        
-        // The payload following the palette header can contain at most 
-        // eight different colours.
-        sPixel color[8];
-    } state;
-    
-    // The buffer size for storing the contents of the graphic file 
-    // is arbitrary.
-    unsigned char buffer[128];
-    
-    // A colour index of zero represents a transparent pixel.
-    memset(&state.color[0], 0x00, sizeof state.color[0]);
-    
-    // Set all alpha values of other colours to their maximum.
-    memset(&state.color[1], 0xFF, sizeof state.color - sizeof state.color[0]);
-    
-    // The algorithm begins by parsing a palette header.
-    state.colors = 255;
-    state.colorIndex = 1;
-    state.parsingHeader = PROBING_COLORS;
-    
-    // The brushes are responsible for pointing to the 
-    // next pixel to write over.
-    brush.head = dst;
-    brush.tail = dst + CHUNK_PIXELS-1;
-    state.pixelsLeftInChunk = CHUNK_PIXELS;
-    state.pixels.tail = 0;
-    state.pixels.left = stridePixels;
-    state.thereIsTail = 0;
-    
-    do {
-        unsigned int bufferIndex;
-        
-        // The palette header describes pixel colours as RGB24. This 
-        // format stores a pixel with three bytes.
-        if (!ReadFile(hf, buffer, sizeof buffer, &ioBytes, NULL)) {
-            return 1;
-            
-        }
-        
-        for (bufferIndex = 0; bufferIndex < ioBytes; ) {
-            unsigned char byte;
-            
-            if (state.pixelsLeftInChunk == 0) {
-                state.pixelsLeftInChunk = CHUNK_PIXELS;
-                dst += CHUNK_PIXELS;
-                brush.head = dst;
-                brush.tail = dst + CHUNK_PIXELS-1;
-                state.pixels.left -= CHUNK_PIXELS;
-                
-                // Do not increment the byte index, as this phase 
-                // does not get information.
-                continue;
-                
-            } else if (state.pixels.left == 0) {
-                state.colorIndex = 1;
-                state.colors = 255;
-                state.parsingHeader = PROBING_COLORS;
-                state.pixels.left = stridePixels;
-                continue;
-                
-            } else {
-                byte = buffer[bufferIndex++];
-                
-            }
-            
-            // Allow one more color for capturing all colours in the 
-            // header.
-            if (state.colors) {
-                switch (state.parsingHeader) {
-                    case PROBING_COLORS: {
-                        state.colors = byte;
-                        state.parsingHeader = PROBING_BLUE;
-                        continue;
-                        
-                    }
-                    
-                    case PROBING_BLUE: {
-                        state.color[state.colorIndex].b = byte;
-                        state.parsingHeader = PROBING_GREEN;
-                        continue;
-                        
-                    }
-                    
-                    case PROBING_GREEN: {
-                        state.color[state.colorIndex].g = byte;
-                        state.parsingHeader = PROBING_RED;
-                        continue;
-                        
-                    }
-                    
-                    case PROBING_RED: {
-                        state.color[state.colorIndex].r = byte;
-                        state.parsingHeader = PROBING_BLUE;
-                        ++state.colorIndex;
-                        --state.colors;
-                        continue;
-                        
-                    }
-                    
-                    default:
-                }
-                
-            } else {
-                if (state.thereIsTail) {
-                    state.pixels.head = (unsigned char)(state.pixels.head 
-                        << DOUBLE_HIGH_HEAD_SHIFT)
-                        | ((byte&DOUBLE_MASK_HEAD_LENGTH)
-                        >> DOUBLE_LOW_HEAD_SHIFT);
-                    state.pixels.tail = (unsigned char)
-                        (byte&DOUBLE_MASK_TAIL_LENGTH) 
-                        >> DOUBLE_SHIFT_TAIL_LENGTH;
-                    
-                    state.pixelsLeftInChunk = (unsigned char)
-                        (state.pixelsLeftInChunk - state.pixels.tail);
-                    
-                    while (state.pixels.tail--) {
-                        *brush.tail-- = state.color[state.colorIndex];
-                    }
-                    
-                    // The algorithm covered the tail portion of the 
-                    // datum at this point.
-                    state.thereIsTail = 0;
-                    
-                } else {
-                    state.colorIndex = (byte&MASK_COLOR) >> SHIFT_COLOR;
-                    state.pixels.head = (byte&SINGLE_MASK_LENGTH) 
-                        >> SINGLE_SHIFT_LENGTH;
-                    state.thereIsTail = byte&MASK_THERE_IS_TAIL;
-                    if (state.thereIsTail) {
-                        continue;
-                        
-                    }
-                    
-                }
-                
-                state.pixelsLeftInChunk = (unsigned char) 
-                    (state.pixelsLeftInChunk - state.pixels.head);
-                
-                while (state.pixels.head--) {
-                    *brush.head++ = state.color[state.colorIndex];
-                }
-                
-            }
-        }
-        
-        // The algorithm relies on the size of the file to determine 
-        // when to end.
-    } while (ioBytes == sizeof buffer);
-    
-    return 0;
 }
\ No newline at end of file
@@ -2,12 +2,6 @@
 
 #define VIEWPORT_BPP (8*sizeof(sPixel))
 
-#define UNIQUE_TILES 16U
-
-typedef struct {
-    unsigned char b, g, r, a;
-} sPixel;
-
 HBITMAP initAtlas(HDC sourceDc, BITMAPINFO *bi);
 HBITMAP allocGfx(HDC sourceDc, BITMAPINFO *bi, unsigned int w, 
     unsigned int h);
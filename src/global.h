@@ -95,6 +95,11 @@ typedef struct {
 
 // XXX: Make unsigned?
 #define TILE_PELS 16
+#define UNIQUE_TILES 16U
+
+typedef struct {
+    unsigned char b, g, r, a;
+} sPixel;
 
 #define _HEADER_GLOBAL
 #endif
\ No newline at end of file
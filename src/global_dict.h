@@ -5,12 +5,24 @@
 #define WINDOW_MENU_NAME WINDOW_TITLE_NAME
 
 #define EXTENSION_GFX ".cfg"
+#define EXTENSION_SPRITE_CACHE ".spc"
 
-#define DIR_MOLDINFO "user\\Mukki\\moldInfo.txt"
-#define DIR_ATLAS "user\\Mukki\\atlas" EXTENSION_GFX
+// The headless tools build on other platforms than Windows. These 
+// platforms separate directories with forward slashes instead.
+#ifdef _WIN32
+#define DIR_SEP "\\"
+#else
+#define DIR_SEP "/"
+#endif
+
+#define DIR_MOLDINFO "user" DIR_SEP "Mukki" DIR_SEP "moldInfo.txt"
+#define DIR_ATLAS "user" DIR_SEP "Mukki" DIR_SEP "atlas" EXTENSION_GFX
 #define DIR_SPRITE "enemy"
-#define DIR_LEVEL_TILEMAP "user\\Abe\\tuto.lvl"
-#define DIR_LEVEL_GEN "user\\Abe\\tuto.gen"
+#define DIR_LEVEL_TILEMAP "user" DIR_SEP "Abe" DIR_SEP "tuto.lvl"
+#define DIR_LEVEL_GEN "user" DIR_SEP "Abe" DIR_SEP "tuto.gen"
+#define DIR_LEVEL_SPAWNS "user" DIR_SEP "Abe" DIR_SEP "tuto.spn"
+#define DIR_INPUT_LOG "user" DIR_SEP "last.rec"
+#define DIR_ARCHIVE "user" DIR_SEP "assets.pak"
 
 #define _HEADER_GLOBALDICT
 #endif
\ No newline at end of file
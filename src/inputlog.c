@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "logic.h"
+#include "inputlog.h"
+#include "archive.h"
+
+// The file starts with a signature, the amount of ticks, the hash of 
+// the cast after the last tick and the amount of runs. Each run then 
+// takes a byte for its keys, two bytes for its amount of ticks, and 
+// the hold duration of each key if the run is anchored. All integers 
+// are little-endian.
+#define INPUT_LOG_SIGNATURE "MIRI"
+#define INPUT_LOG_ANCHORED 0x80U
+
+// Gather the keys that are down into a key set.
+static unsigned char getKeys(sInput const *input) {
+    sKey const *a = &input->right;
+    unsigned int i, keys = 0;
+    
+    for (i = 0; i < KEYS; ++i) {
+        keys |= a[i].holdDur != 0 ? 1U << i : 0U;
+    }
+    
+    return (unsigned char) keys;
+}
+
+void getRunInput(sInputRun const *run, unsigned int tick, sInput *dst) {
+    sKey const *a = &run->start.right;
+    sKey *b = &dst->right;
+    unsigned int i;
+    
+    for (i = 0; i < KEYS; ++i) {
+        b[i].holdDur = (unsigned char)
+            ((unsigned int) run->keys >> i & 1U ? a[i].holdDur + tick : 0U);
+    }
+    
+    return;
+}
+
+int logInput(sInputLog *log, sInput const *input) {
+    unsigned char const keys = getKeys(input);
+    sInputRun *run = log->count != 0 ? &log->runs[log->count-1U] : NULL;
+    sInput next = log->last;
+    
+    pressKeys(&next, keys);
+    if (run != NULL && run->keys == keys && run->ticks < INPUT_RUN_TICKS_MAX
+            && memcmp(&next, input, sizeof next) == 0) {
+        ++run->ticks;
+        
+    } else {
+        if (log->count == log->capacity) {
+            unsigned int const capacity = log->capacity
+                ? 2U*log->capacity : 64U;
+            sInputRun *grown = realloc(log->runs, capacity * sizeof*grown);
+            
+            if (grown == NULL) {
+                return 1;
+                
+            }
+            log->runs = grown;
+            log->capacity = capacity;
+            
+        }
+        
+        run = &log->runs[log->count++];
+        run->start = *input;
+        run->ticks = 1;
+        run->keys = keys;
+        run->anchored = memcmp(&next, input, sizeof next) != 0;
+        
+    }
+    
+    log->last = *input;
+    ++log->ticks;
+    return 0;
+}
+
+void unlogInput(sInputLog *log) {
+    sInputRun *run;
+    
+    if (log->count == 0) {
+        return;
+        
+    }
+    
+    run = &log->runs[log->count-1U];
+    if (--run->ticks == 0) {
+        --log->count;
+        
+    }
+    --log->ticks;
+    
+    if (log->count == 0) {
+        memset(&log->last, 0x00, sizeof log->last);
+        
+    } else {
+        run = &log->runs[log->count-1U];
+        getRunInput(run, run->ticks - 1U, &log->last);
+        
+    }
+    return;
+}
+
+int saveInputLog(sInputLog const *log, char const *path, unsigned long hash) {
+    unsigned char buffer[16];
+    unsigned int i;
+    FILE *f;
+    int failed;
+    
+    f = fopen(path, "wb");
+    if (f == NULL) {
+        return 1;
+        
+    }
+    
+    memcpy(buffer, INPUT_LOG_SIGNATURE, 4);
+    putInteger(buffer + 4, log->ticks, 4);
+    putInteger(buffer + 8, hash, 4);
+    putInteger(buffer + 12, log->count, 4);
+    failed = fwrite(buffer, 16, 1, f) != 1;
+    for (i = 0; i < log->count && !failed; ++i) {
+        sInputRun const *run = &log->runs[i];
+        sKey const *a = &run->start.right;
+        unsigned int bytes = 3, k;
+        
+        buffer[0] = (unsigned char)
+            (run->keys | (run->anchored ? INPUT_LOG_ANCHORED : 0U));
+        putInteger(buffer + 1, run->ticks, 2);
+        if (run->anchored) {
+            for (k = 0; k < KEYS; ++k) {
+                buffer[bytes++] = a[k].holdDur;
+            }
+            
+        }
+        failed = fwrite(buffer, bytes, 1, f) != 1;
+    }
+    
+    return fclose(f) != 0 || failed;
+}
+
+int loadInputLog(sInputLog *log, char const *path, unsigned long *hash) {
+    unsigned char buffer[16];
+    unsigned long ticks;
+    unsigned int i, count;
+    FILE *f;
+    
+    f = fopen(path, "rb");
+    if (f == NULL) {
+        return 1;
+        
+    }
+    
+    if (fread(buffer, 16, 1, f) != 1
+            || memcmp(buffer, INPUT_LOG_SIGNATURE, 4) != 0) {
+        fclose(f);
+        return 1;
+        
+    }
+    ticks = getInteger(buffer + 4, 4);
+    *hash = getInteger(buffer + 8, 4);
+    count = (unsigned int) getInteger(buffer + 12, 4);
+    
+    freeInputLog(log);
+    log->runs = malloc((count ? count : 1U) * sizeof*log->runs);
+    if (log->runs == NULL) {
+        fclose(f);
+        return 1;
+        
+    }
+    log->capacity = count;
+    
+    for (i = 0; i < count; ++i) {
+        sInputRun *run = &log->runs[i];
+        sKey *a = &run->start.right;
+        unsigned int k;
+        
+        if (fread(buffer, 3, 1, f) != 1) {
+            break;
+            
+        }
+        run->keys = (unsigned char) (buffer[0] & ~INPUT_LOG_ANCHORED);
+        run->anchored = (buffer[0] & INPUT_LOG_ANCHORED) != 0;
+        run->ticks = (unsigned short) getInteger(buffer + 1, 2);
+        if (run->ticks == 0) {
+            break;
+            
+        }
+        
+        // Runs that are not anchored follow from the previous tick.
+        if (run->anchored) {
+            if (fread(buffer, KEYS, 1, f) != 1) {
+                break;
+                
+            }
+            for (k = 0; k < KEYS; ++k) {
+                a[k].holdDur = buffer[k];
+            }
+            
+        } else {
+            run->start = log->last;
+            pressKeys(&run->start, run->keys);
+            
+        }
+        getRunInput(run, run->ticks - 1U, &log->last);
+        log->ticks += run->ticks;
+        log->count++;
+    }
+    
+    fclose(f);
+    return log->count != count || log->ticks != ticks;
+}
+
+void freeInputLog(sInputLog *log) {
+    free(log->runs);
+    memset(log, 0x00, sizeof*log);
+    return;
+}
\ No newline at end of file
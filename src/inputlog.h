@@ -0,0 +1,42 @@
+#ifndef _HEADER_INPUTLOG
+
+// An input log holds the inputs of every tick of a session as runs of 
+// ticks. The same keys stay down during a run, and the hold duration of 
+// each of these keys grows by one every tick. A run is anchored to its 
+// own hold durations if these do not follow from the previous tick, 
+// like after rewinding.
+#define INPUT_RUN_TICKS_MAX 0xFFFFU
+typedef struct {
+    sInput start;
+    unsigned short ticks;
+    unsigned char keys, anchored;
+} sInputRun;
+
+typedef struct {
+    sInputRun *runs;
+    unsigned int count, capacity;
+    unsigned long ticks;
+    
+    // Inputs of the latest tick
+    sInput last;
+} sInputLog;
+
+// Append the inputs of a tick. The log must be zeroed before its first 
+// use. The function returns non-zero if the log cannot grow.
+int logInput(sInputLog *log, sInput const *input);
+
+// Drop the latest tick, if any.
+void unlogInput(sInputLog *log);
+
+// Rebuild the inputs of a tick from the start of its run.
+void getRunInput(sInputRun const *run, unsigned int tick, sInput *dst);
+
+// The file of a log also keeps the hash of the cast after its last 
+// tick. Both functions return non-zero on failure. Loading replaces 
+// the contents of the log.
+int saveInputLog(sInputLog const *log, char const *path, unsigned long hash);
+int loadInputLog(sInputLog *log, char const *path, unsigned long *hash);
+void freeInputLog(sInputLog *log);
+
+#define _HEADER_INPUTLOG
+#endif
\ No newline at end of file
@@ -1,9 +1,11 @@
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "global.h"
+#include "global_dict.h"
 #include "logic.h"
+#include "archive.h"
+#include "mapping.h"
 
 enum {
     MOLDID_PLAYER,
@@ -11,11 +13,20 @@ enum {
     MOLDID_NINGEN = 2
 };
 
-static int loadLevel(sLevel *dst);
+static void unpackTiles(TILE *dst, unsigned char const *src,
+    unsigned long tiles);
+static void packTiles(unsigned char *dst, TILE const *src,
+    unsigned long tiles);
 static int initActorData(sCast *c, sCoord defaultPos);
+static int initCheckpoints(sScene *s);
+static int initRewind(sScene *s);
+static void copyCastHead(sCast *dst, sCast const *src);
+static int growCast(sCast *c, unsigned int capacity);
+static unsigned int takeSlot(sCast *c);
+static void linkActor(sCast *c, unsigned int slot);
 
 int initContext(sScene *s) {
-    if (loadLevel(&s->level)) {
+    if (loadLevel(&s->level, DIR_LEVEL_TILEMAP)) {
         return 1;
         
     }
@@ -25,132 +36,475 @@ int initContext(sScene *s) {
         
     }
     
+    s->lod.radius = LOD_RADIUS_DEFAULT;
+    s->lod.divisor = LOD_DIVISOR_DEFAULT;
+    
+    // The game resets the scene to the first checkpoint when the 
+    // player dies, and can rewind the latest ticks.
+    if (initCheckpoints(s) || initRewind(s)) {
+        return 1;
+        
+    }
+    
+    s->grid.stale = 1;
     return 0;
 }
 
-// Store a non-constant version of the pointer to the tilemap to free 
-// it eventually.
-static TILE *tileData;
+int cloneContext(sScene *dst, sScene const *src) {
+    memset(dst, 0x00, sizeof*dst);
+    dst->md = src->md;
+    dst->level = src->level;
+    dst->level.block = NULL;
+    dst->level.file = NULL;
+    dst->lod = src->lod;
+    if (copyCast(&dst->cast, &src->cast) || initCheckpoints(dst)) {
+        return 1;
+        
+    }
+    
+    dst->grid.stale = 1;
+    return 0;
+}
 
-int freeLevelData(void) {
-    if (tileData != NULL) {
-        free(tileData);
+unsigned int getCameraLeft(sScene const *s) {
+    sCast const *c = &s->cast;
+    unsigned int const center = c->x[ACTOR_PLAYER]
+        + s->md.data[c->moldId[ACTOR_PLAYER]].w/2U;
+    unsigned int const width = (unsigned int) (TILE_PELS*s->level.w);
+    
+    if (center < VIEWPORT_WIDTH/2U) {
         return 0;
         
+    } else if (center + VIEWPORT_WIDTH/2U >= width) {
+        return width - (unsigned int) VIEWPORT_WIDTH;
+        
+    }
+    
+    return center - VIEWPORT_WIDTH/2U;
+}
+
+int freeLevel(sLevel *l) {
+    if (l->block == NULL && l->file == NULL) {
+        return 1;
+        
+    }
+    
+    free(l->block);
+    l->block = NULL;
+    if (l->file != NULL) {
+        unmapFile(l->file, l->fileBytes);
+        l->file = NULL;
+        
     }
-    return 1;
+    
+    return 0;
 }
 
 #include <limits.h>
 
-#include "global_dict.h"
-
 #define ACTOR_DEFAULT_HEALTH 1
 
 #define LEVEL_HEADER_BYTES 6U
 #define LEVEL_HEADER_COORD_BITS 12U
 #define LEVEL_HEADER_COORDS 4U
-static int loadLevel(sLevel *dst) {
-    FILE *f;
-    char buffer[64], code;
+#define LEVEL_TILES_MAX ~~(USHRT_MAX/TILE_PELS)
+#define SOLID_WORD_BITS ~~(sizeof(SOLID_WORD)*CHAR_BIT)
+#define CLEAR_UNBOUNDED USHRT_MAX
+
+// Extend a run of tiles that are not solid by one tile. Runs that reach 
+// the end of the level stay unbounded.
+static unsigned short clearRun(unsigned short run, TILE t) {
+    if (t % SOLID_TILE_PERIOD == 0) {
+        return 0;
+        
+    }
     
-    f = fopen(DIR_LEVEL_TILEMAP, "rb");
-    if (f == NULL) {
+    return run == CLEAR_UNBOUNDED ? run : (unsigned short) (run + 1U);
+}
+
+// Parse the header of a version 1 level file, whose tiles follow the 
+// header.
+static int readLevelV1(sLevel *dst, sAsset const *file) {
+    unsigned short *coordAsTiles[LEVEL_HEADER_COORDS];
+    unsigned char const *header = file->bytes;
+    unsigned long byteIndex;
+    unsigned int bitsLeft, coordIndex;
+    unsigned short value;
+    
+    if (file->size < LEVEL_HEADER_BYTES) {
         return 1;
         
     }
     
-    do {
-        unsigned short *coordAsTiles[LEVEL_HEADER_COORDS];
-        unsigned long byteIndex, tiles, tileIndex;
-        unsigned int bitsLeft, coordIndex, ioBytes;
-        unsigned short value;
+    // Set up the memory addresses of the level attributes.
+    coordAsTiles[0] = &dst->w;
+    coordAsTiles[1] = &dst->h;
+    coordAsTiles[2] = &dst->spawn.x;
+    coordAsTiles[3] = &dst->spawn.y;
+    for (byteIndex = 0, bitsLeft = LEVEL_HEADER_COORD_BITS,
+            coordIndex = 0, value = 0;
+            coordIndex < ARRAY_ELEMENTS(coordAsTiles);
+            ++byteIndex) {
+        unsigned char const byte = header[byteIndex];
         
-        if ((ioBytes = (unsigned int)
-                fread(buffer, sizeof*buffer, LEVEL_HEADER_BYTES, f))
-                != LEVEL_HEADER_BYTES) {
-            code = 1;
-            break;
+        // Assume that the sequence of bits of a value can straddle 
+        // over two bytes.
+        if (bitsLeft >= CHAR_BIT) {
+            bitsLeft -= CHAR_BIT;
+            value = (unsigned short) (value+byte);
+            
+        } else {
+            unsigned short const remainder = (unsigned short)
+                (byte>>(CHAR_BIT-bitsLeft));
+            value = (unsigned short) (value+remainder);
+            
+            *coordAsTiles[coordIndex++] = value;
+            value = (unsigned short) (byte - (remainder<<bitsLeft));
+            bitsLeft = (unsigned int)
+                (LEVEL_HEADER_COORD_BITS - (CHAR_BIT-bitsLeft));
             
         }
         
-        // Set up the memory addresses of the level attributes.
-        coordAsTiles[0] = &dst->w;
-        coordAsTiles[1] = &dst->h;
-        coordAsTiles[2] = &dst->spawn.x;
-        coordAsTiles[3] = &dst->spawn.y;
-        for (byteIndex = 0, bitsLeft = LEVEL_HEADER_COORD_BITS, 
-                coordIndex = 0, value = 0;
-                coordIndex < ARRAY_ELEMENTS(coordAsTiles); 
-                ++byteIndex) {
-            unsigned char const byte = (unsigned char) buffer[byteIndex];
-            
-            // Assume that the sequence of bits of a value can straddle 
-            // over two bytes.
-            if (bitsLeft >= CHAR_BIT) {
-                bitsLeft -= CHAR_BIT;
-                value = (unsigned short) (value+byte);
-                
-            } else {
-                unsigned short const remainder = (unsigned short)
-                    (byte>>(CHAR_BIT-bitsLeft));
-                value = (unsigned short) (value+remainder);
-                
-                *coordAsTiles[coordIndex++] = value;
-                value = (unsigned short) (byte - (remainder<<bitsLeft));
-                bitsLeft = (unsigned int)
-                    (LEVEL_HEADER_COORD_BITS - (CHAR_BIT-bitsLeft));
-                
-            }
+        value = (unsigned short) (value << bitsLeft);
+    }
+    
+    // The file must hold every tile that its header announces, since 
+    // the game reads the tiles right from the file.
+    if ((file->size - LEVEL_HEADER_BYTES)*2U
+            < (unsigned long)dst->w * dst->h) {
+        return 1;
+        
+    }
+    
+    dst->tiles = header + LEVEL_HEADER_BYTES;
+    return 0;
+}
+
+// Parse the header of a version 2 level file, and check that its index 
+// of chunks lies within the file.
+static int readLevelV2(sLevel *dst, sAsset const *file,
+        unsigned long *chunkColumns, unsigned long *chunks) {
+    unsigned char const *header = file->bytes;
+    unsigned long w, h, x, y;
+    
+    if (file->size < LEVEL_V2_HEADER_BYTES) {
+        return 1;
+        
+    }
+    
+    w = getInteger(header + 4, 4);
+    h = getInteger(header + 8, 4);
+    x = getInteger(header + 12, 4);
+    y = getInteger(header + 16, 4);
+    *chunkColumns = getInteger(header + 20, 4);
+    *chunks = getInteger(header + 24, 4);
+    if (w > LEVEL_TILES_MAX || h > LEVEL_TILES_MAX || x >= w || y >= h
+            || *chunkColumns == 0
+            || *chunks != (w + *chunkColumns-1U) / *chunkColumns
+            || *chunks > (file->size - LEVEL_V2_HEADER_BYTES)
+            / LEVEL_V2_ENTRY_BYTES) {
+        return 1;
+        
+    }
+    
+    dst->w = (unsigned short) w;
+    dst->h = (unsigned short) h;
+    dst->spawn.x = (unsigned short) x;
+    dst->spawn.y = (unsigned short) y;
+    return 0;
+}
+
+// Decode the tiles of one chunk, on its own, to a byte per tile. The 
+// function returns non-zero if the chunk does not hold exactly the 
+// given amount of tiles.
+static int decodeChunk(TILE *dst, unsigned long tiles,
+        unsigned char const *src, unsigned long bytes, unsigned long encoding) {
+    unsigned long i, tile;
+    
+    if (encoding == LEVEL_CHUNK_PACKED) {
+        if (bytes != (tiles + 1U)/2U) {
+            return 1;
             
-            value = (unsigned short) (value << bitsLeft);
         }
         
-        // Scale the player spawn coordinates according to the size 
-        // of tiles.
-        dst->spawn.x = (unsigned short)(dst->spawn.x * TILE_PELS);
-        dst->spawn.y = (unsigned short)(dst->spawn.y * TILE_PELS);
+        unpackTiles(dst, src, tiles);
+        return 0;
+        
+    } else if (encoding != LEVEL_CHUNK_RUNS) {
+        return 1;
+        
+    }
+    
+    for (i = 0, tile = 0; i < bytes; ++i) {
+        unsigned long const run = (src[i] >> 4) + 1U;
         
-        tiles = (unsigned long)dst->w * (unsigned long)dst->h;
-        tileData = malloc((size_t)tiles * sizeof*tileData);
-        if (tileData == NULL) {
-            code = 1;
-            break;
+        if (run > tiles - tile) {
+            return 1;
             
         }
         
-        tileIndex = 0;
-        do {
-            while (byteIndex < ioBytes) {
-                char const byte = buffer[byteIndex++];
-                tileData[tileIndex++] = (TILE) ((byte&0xF0) >> 4);
-                tileData[tileIndex++] = (TILE) (byte&0x0F);
-                
-            }
-            byteIndex = 0;
+        memset(&dst[tile], src[i] & 0x0F, run);
+        tile += run;
+    }
+    
+    return tile != tiles;
+}
+
+// Decode every chunk of a version 2 level file, in the order of the 
+// columns.
+static int decodeChunks(sLevel const *l, sAsset const *file, TILE *dst,
+        unsigned long chunkColumns, unsigned long chunks) {
+    unsigned long chunk;
+    
+    for (chunk = 0; chunk < chunks; ++chunk) {
+        unsigned char const *entry = file->bytes + LEVEL_V2_HEADER_BYTES
+            + chunk*LEVEL_V2_ENTRY_BYTES;
+        unsigned long const offset = getInteger(entry, 4),
+            bytes = getInteger(entry + 4, 4),
+            column = chunk*chunkColumns,
+            columns = l->w - column < chunkColumns
+                ? l->w - column : chunkColumns;
+        
+        if (offset > file->size || bytes > file->size - offset
+                || decodeChunk(&dst[column*l->h], columns*l->h,
+                file->bytes + offset, bytes, getInteger(entry + 8, 4))) {
+            return 1;
             
-            ioBytes = (unsigned int)fread(buffer, sizeof*buffer, 
-                ARRAY_ELEMENTS(buffer), f);
-        } while (ioBytes != 0);
+        }
+    }
+    
+    return 0;
+}
+
+// The level stores its bitmap first, then its tables, such that every 
+// array stays aligned. The tiles of version 1 files stay in the file, 
+// while the tiles of version 2 files follow the tables. The loader 
+// unpacks the tiles into a temporary array to build the bitmap and the 
+// tables.
+int loadLevel(sLevel *dst, char const *path) {
+    sAsset file;
+    TILE *tileData;
+    SOLID_WORD *solidData;
+    unsigned short *clearData;
+    unsigned char *at;
+    unsigned long tiles, packedBytes, chunkColumns = 0, chunks = 0;
+    unsigned int row, column;
+    int v2;
+    
+    dst->block = NULL;
+    if (openAsset(&file, path)) {
+        closeAsset(&file);
+        dst->file = NULL;
+        return 1;
         
-        dst->data = tileData;
-        code = 0;
-    } while (0);
+    }
+    dst->file = file.view;
+    dst->fileBytes = file.size;
     
-    fclose(f);
+    v2 = file.size >= sizeof LEVEL_V2_SIGNATURE - 1U
+        && memcmp(file.bytes, LEVEL_V2_SIGNATURE,
+        sizeof LEVEL_V2_SIGNATURE - 1U) == 0;
+    if (v2 ? readLevelV2(dst, &file, &chunkColumns, &chunks)
+            : readLevelV1(dst, &file)) {
+        freeLevel(dst);
+        return 1;
+        
+    }
     
-    return code;
+    // Scale the player spawn coordinates according to the size 
+    // of tiles.
+    dst->spawn.x = (unsigned short)(dst->spawn.x * TILE_PELS);
+    dst->spawn.y = (unsigned short)(dst->spawn.y * TILE_PELS);
+    
+    tiles = (unsigned long)dst->w * (unsigned long)dst->h;
+    packedBytes = v2 ? (tiles + 1U)/2U : 0;
+    dst->solidStride = (unsigned short)
+        ((dst->h + SOLID_WORD_BITS-1U) / SOLID_WORD_BITS);
+    dst->block = malloc((size_t)dst->w * dst->solidStride
+        * sizeof*solidData + 2U * (size_t)tiles * sizeof*clearData
+        + (size_t)packedBytes);
+    tileData = malloc((size_t)tiles * sizeof*tileData);
+    if (dst->block == NULL || tileData == NULL) {
+        free(tileData);
+        freeLevel(dst);
+        return 1;
+        
+    }
+    at = dst->block;
+    solidData = (void*) at;
+    at += (size_t)dst->w * dst->solidStride * sizeof*solidData;
+    clearData = (void*) at;
+    at += 2U * (size_t)tiles * sizeof*clearData;
+    
+    if (!v2) {
+        unpackTiles(tileData, dst->tiles, tiles);
+        
+    } else if (decodeChunks(dst, &file, tileData, chunkColumns, chunks)) {
+        free(tileData);
+        freeLevel(dst);
+        return 1;
+        
+    } else {
+        packTiles(at, tileData, tiles);
+        dst->tiles = at;
+        
+    }
+    
+    // Build the solidity bitmap from the complete tilemap.
+    memset(solidData, 0x00,
+        (size_t)dst->w * dst->solidStride * sizeof*solidData);
+    for (column = 0; column < dst->w; ++column) {
+        TILE const *t = &tileData[column*dst->h];
+        SOLID_WORD *words = &solidData[column*dst->solidStride];
+        
+        for (row = 0; row < dst->h; ++row) {
+            words[row/SOLID_WORD_BITS] |= (SOLID_WORD)
+                (t[row] % SOLID_TILE_PERIOD == 0) << row%SOLID_WORD_BITS;
+        }
+    }
+    
+    dst->solid = solidData;
+    
+    // Line of sight checks look along rows of tiles.
+    dst->clearLeft = clearData;
+    dst->clearRight = clearData + tiles;
+    for (row = 0; row < dst->h; ++row) {
+        unsigned short *left = clearData + row*dst->w,
+            *right = clearData + tiles + row*dst->w;
+        unsigned short run;
+        
+        for (column = 0, run = CLEAR_UNBOUNDED; column < dst->w;
+                ++column) {
+            run = clearRun(run, tileData[column*dst->h + row]);
+            left[column] = run;
+        }
+        for (column = dst->w, run = CLEAR_UNBOUNDED; column-- > 0;) {
+            run = clearRun(run, tileData[column*dst->h + row]);
+            right[column] = run;
+        }
+    }
+    
+    free(tileData);
+    return 0;
+}
+
+// Place an actor in the next slot of a cast. An entry without a valid 
+// mold leaves its slot free.
+static int placeActor(sCast *c, sActor const *a) {
+    unsigned int const slot = takeSlot(c);
+    
+    if (slot == ACTOR_SLOT_NONE) {
+        return 1;
+        
+    }
+    
+    setActor(c, slot, a);
+    if (a->moldId < MOLDS) {
+        linkActor(c, slot);
+        ++c->live;
+        
+    } else {
+        c->moldId[slot] = MOLD_NULL;
+        c->nextFree[slot] = c->freeSlot;
+        c->freeSlot = (unsigned short) slot;
+        
+    }
+    
+    return 0;
+}
+
+static int spawnEntry(sActor const *a, void *ctx) {
+    return placeActor(ctx, a);
 }
 
-// The game remembers the original configuration of actors in the 
-// `sCast` struct. The game resets the scene to this actor 
-// configuration when the player dies.
-static sCast initialCast;
+// Place the actors of a compiled spawn table. A coordinate of 
+// `SPAWN_COORD_START` stands for the coordinate of the spawn of the 
+// level.
+static int loadSpawnTable(sCast *c, unsigned char const *table,
+        unsigned long bytes, sCoord start) {
+    unsigned long count, i;
+    
+    if (bytes < SPAWN_HEADER_BYTES
+            || memcmp(table, SPAWN_SIGNATURE, 4) != 0) {
+        return 1;
+        
+    }
+    
+    count = getInteger(table + 4, 4);
+    if (count > (bytes - SPAWN_HEADER_BYTES) / SPAWN_RECORD_BYTES
+            || bytes - SPAWN_HEADER_BYTES != count*SPAWN_RECORD_BYTES) {
+        return 1;
+        
+    }
+    
+    for (i = 0; i < count; ++i) {
+        unsigned char const *record = table + SPAWN_HEADER_BYTES
+            + i*SPAWN_RECORD_BYTES;
+        unsigned short const x = (unsigned short) getInteger(record, 2);
+        unsigned short const y = (unsigned short) getInteger(record + 2, 2);
+        sActor a;
+        
+        a.pos.x = x == SPAWN_COORD_START ? start.x : x;
+        a.pos.y = y == SPAWN_COORD_START ? start.y : y;
+        a.vel.subX = 0;
+        a.vel.y = 0;
+        a.moldId = record[4];
+        a.health = (signed char) record[5];
+        a.frame = 0;
+        a.timer = 0;
+        if (placeActor(c, &a)) {
+            return 1;
+            
+        }
+    }
+    
+    return 0;
+}
 
+// The game prefers the compiled spawn table of the level, and parses 
+// the text form of the spawn list without it. A table that was compiled 
+// from another version of the text form does not count. The slots of 
+// the actors follow the order of the entries.
 static int initActorData(sCast *c, sCoord defaultPos) {
-    FILE *f;
-    char buffer[64];
-    unsigned int ioBytes, actorIndex;
+    sAsset table;
+    unsigned long stamp;
+    unsigned int i;
+    int code;
+    
+    // The level can place more actors than the default limit.
+    c->slots = c->live = 0;
+    c->limit = ACTOR_LIMIT_DEFAULT;
+    c->freeSlot = c->deadSlot = ACTOR_SLOT_NONE;
+    for (i = 0; i < MOLDS; ++i) {
+        c->oldest[i] = c->youngest[i] = ACTOR_SLOT_NONE;
+    }
+    
+    // The table stands on its own when the text form is missing.
+    if (!openAsset(&table, DIR_LEVEL_SPAWNS)
+            && table.size >= SPAWN_HEADER_BYTES
+            && (stampAsset(DIR_LEVEL_GEN, &stamp)
+            || getInteger(table.bytes + 8, 4) == stamp)) {
+        code = loadSpawnTable(c, table.bytes, table.size, defaultPos);
+        
+    } else {
+        code = parseSpawnText(DIR_LEVEL_GEN, defaultPos, spawnEntry, c);
+        
+    }
+    closeAsset(&table);
+    
+    if (c->live > c->limit) {
+        c->limit = c->live;
+        
+    }
+    
+    return code;
+}
+
+int parseSpawnText(char const *path, sCoord defaultPos,
+        int (*spawn)(sActor const *a, void *ctx), void *ctx) {
+    sAsset file;
+    unsigned long byteIndex;
+    sActor actor;
     struct {
         char keyword[4];
         unsigned short number;
@@ -170,8 +524,8 @@ static int initActorData(sCast *c, sCoord defaultPos) {
         } search;
     } state;
     
-    f = fopen(DIR_LEVEL_GEN, "rb");
-    if (f == NULL) {
+    if (openAsset(&file, path)) {
+        closeAsset(&file);
         return 1;
         
     }
@@ -180,229 +534,537 @@ static int initActorData(sCast *c, sCoord defaultPos) {
     state.search = SEARCH_PREPARE;
     state.number = 0U;
     state.parse = PARSE_WHITESPACE;
-    actorIndex = 0U;
-    while ((ioBytes = (unsigned int)
-            fread(buffer, sizeof*buffer, sizeof buffer, f)) != 0) {
-        unsigned int byteIndex = 0;
-        
-        while (byteIndex < ioBytes) {
-            struct {
-                char const enemy[4];
-                char const coord[2];
-                char const health[2];
-            } const vocab = {
-                "teki",
-                "xy",
-                "hp"
-            };
-            char byte;
-            
-            if (state.search == SEARCH_PREPARE) {
-                
-                // Default per-enemy attributes.
-                c->actorData.actor[actorIndex].pos = defaultPos;
-                c->actorData.actor[actorIndex].vel.subX = 0;
-                c->actorData.actor[actorIndex].vel.y = 0;
-                c->actorData.actor[actorIndex].moldId = MOLD_NULL;
-                c->actorData.actor[actorIndex].health = ACTOR_DEFAULT_HEALTH;
-                
-                // An actor faces rightwards by default.
-                c->actorData.actor[actorIndex].frame = 0;
-                
-                // All actors begin their respective timers at zero.
-                c->actorData.actor[actorIndex].timer = 0;
-                
-                state.search = SEARCH_ENTRY;
-                
-            }
-            byte = buffer[byteIndex++];
+    for (byteIndex = 0; byteIndex < file.size;) {
+        struct {
+            char const enemy[4];
+            char const coord[2];
+            char const health[2];
+        } const vocab = {
+            "teki",
+            "xy",
+            "hp"
+        };
+        char byte;
+        
+        if (state.search == SEARCH_PREPARE) {
+            
+            // Default per-enemy attributes.
+            actor.pos = defaultPos;
+            actor.vel.subX = 0;
+            actor.vel.y = 0;
+            actor.moldId = MOLD_NULL;
+            actor.health = ACTOR_DEFAULT_HEALTH;
+            
+            // An actor faces rightwards by default.
+            actor.frame = 0;
             
-            switch (byte) {
-                case ';': {
-                    if (actorIndex >= ARRAY_ELEMENTS(c->actorData.actor)) {
+            // All actors begin their respective timers at zero.
+            actor.timer = 0;
+            
+            state.search = SEARCH_ENTRY;
+            
+        }
+        byte = (char) file.bytes[byteIndex++];
+        
+        switch (byte) {
+            case ';':
+            // Fall-through
+            case '\n':
+            case '\t':
+            case '\r':
+            case ' ': {
+                if (state.parse == PARSE_NUMBER) {
+                    if (state.search == SEARCH_ENTRY) {
                         break;
                         
                     }
                     
-                }
-                // Fall-through
-                case '\n':
-                case '\t': 
-                case '\r': 
-                case ' ': {
-                    if (state.parse == PARSE_NUMBER) {
-                        sActor (*dst)[MAX_ACTORS] = &c->actorData.actor;
-                        
-                        if (state.search == SEARCH_ENTRY) {
+                    switch (state.search) {
+                        case SEARCH_ENEMY: {
+                            actor.moldId = (unsigned char) state.number;
+                            state.search = SEARCH_ENTRY;
                             break;
                             
                         }
                         
-                        switch (state.search) {
-                            case SEARCH_ENEMY: {
-                                (*dst)[actorIndex].moldId = (unsigned char) 
-                                    state.number;
-                                state.search = SEARCH_ENTRY;
-                                break;
-                                
-                            }
-                            
-                            case SEARCH_COORD_X: {
-                                (*dst)[actorIndex].pos.x = (unsigned short) 
-                                    state.number;
-                                state.search = SEARCH_COORD_Y;
-                                break;
-                                
-                            }
+                        case SEARCH_COORD_X: {
+                            actor.pos.x = state.number;
+                            state.search = SEARCH_COORD_Y;
+                            break;
                             
-                            case SEARCH_COORD_Y: {
-                                (*dst)[actorIndex].pos.y = (unsigned short) 
-                                    state.number;
-                                state.search = SEARCH_ENTRY;
-                                
-                                break;
-                                
-                            }
+                        }
+                        
+                        case SEARCH_COORD_Y: {
+                            actor.pos.y = state.number;
+                            state.search = SEARCH_ENTRY;
                             
-                            case SEARCH_HEALTH: {
-                                (*dst)[actorIndex].health = (signed char) 
-                                    state.number;
-                                state.search = SEARCH_ENTRY;
-                                break;
-                                
-                            }
+                            break;
                             
-                            default:
                         }
-                        state.parse = PARSE_WHITESPACE;
-                        state.number = 0U;
                         
-                    } else if (state.parse != PARSE_WHITESPACE 
-                            && state.parse != PARSE_SEPARATOR) {
-                        state.parse = PARSE_SEPARATOR;
+                        case SEARCH_HEALTH: {
+                            actor.health = (signed char) state.number;
+                            state.search = SEARCH_ENTRY;
+                            break;
+                            
+                        }
                         
+                        default:
                     }
-                    if (byte == ';') {
-                        state.search = SEARCH_PREPARE;
-                        state.parse = PARSE_WHITESPACE;
-                        ++actorIndex;
+                    state.parse = PARSE_WHITESPACE;
+                    state.number = 0U;
+                    
+                } else if (state.parse != PARSE_WHITESPACE
+                        && state.parse != PARSE_SEPARATOR) {
+                    state.parse = PARSE_SEPARATOR;
+                    
+                }
+                if (byte == ';') {
+                    if (spawn(&actor, ctx)) {
+                        closeAsset(&file);
+                        return 1;
                         
                     }
-                    continue;
+                    
+                    state.search = SEARCH_PREPARE;
+                    state.parse = PARSE_WHITESPACE;
                     
                 }
+                continue;
                 
-                case ':': {
-                    state.parse = PARSE_SEPARATOR;
+            }
+            
+            case ':': {
+                state.parse = PARSE_SEPARATOR;
+                
+            }
+            // Fall-through
+            case 't':
+            case 'e':
+            case 'k':
+            case 'i':
+            case 'x':
+            case 'y':
+            case 'h':
+            case 'p':{
+                if (state.parse == PARSE_NUMBER) {
+                    break;
                     
                 }
-                // Fall-through
-                case 't': 
-                case 'e': 
-                case 'k':
-                case 'i':
-                case 'x': 
-                case 'y':
-                case 'h':
-                case 'p':{
-                    if (state.parse == PARSE_NUMBER) {
-                        break;
-                        
-                    }
+                
+                if (state.parse == PARSE_SEPARATOR) {
+                    char const *end =
+                        &state.keyword[sizeof state.keyword];
                     
-                    if (state.parse == PARSE_SEPARATOR) {
-                        char const *end = 
-                            &state.keyword[sizeof state.keyword];
+                    if (memcmp(end - sizeof vocab.enemy, vocab.enemy,
+                            sizeof vocab.enemy) == 0) {
+                        state.search = SEARCH_ENEMY;
                         
-                        if (memcmp(end - sizeof vocab.enemy, vocab.enemy, 
-                                sizeof vocab.enemy) == 0) {
-                            state.search = SEARCH_ENEMY;
-                            
-                        } else if (memcmp(end - sizeof vocab.coord, 
-                                vocab.coord, sizeof vocab.coord) == 0) {
-                            state.search = SEARCH_COORD_X;
-                            
-                        } else if (memcmp(end - sizeof vocab.health, 
-                                vocab.health, sizeof vocab.health) == 0) {
-                            state.search = SEARCH_HEALTH;
-                            
-                        } else {
-                            
-                            // The parser did not recognize a keyword.
-                            break;
-                            
-                        }
+                    } else if (memcmp(end - sizeof vocab.coord,
+                            vocab.coord, sizeof vocab.coord) == 0) {
+                        state.search = SEARCH_COORD_X;
                         
+                    } else if (memcmp(end - sizeof vocab.health,
+                            vocab.health, sizeof vocab.health) == 0) {
+                        state.search = SEARCH_HEALTH;
+                        
+                    } else {
                         
+                        // The parser did not recognize a keyword.
+                        break;
                         
                     }
                     
-                    state.keyword[0] = state.keyword[1];
-                    state.keyword[1] = state.keyword[2];
-                    state.keyword[2] = state.keyword[3];
-                    state.keyword[3] = byte;
-                    state.number = 0U;
-                    state.parse = PARSE_KEYWORD;
-                    continue;
+                    
                     
                 }
                 
-                case '0':
-                case '1':
-                case '2':
-                case '3':
-                case '4':
-                case '5':
-                case '6':
-                case '7':
-                case '8':
-                case '9': {
-                    if (state.search == SEARCH_ENTRY) {
-                        
-                        // A number must follow a keyword. Otherise, 
-                        // syntax is illegal.
-                        break;
-                        
-                    }
+                state.keyword[0] = state.keyword[1];
+                state.keyword[1] = state.keyword[2];
+                state.keyword[2] = state.keyword[3];
+                state.keyword[3] = byte;
+                state.number = 0U;
+                state.parse = PARSE_KEYWORD;
+                continue;
+                
+            }
+            
+            case '0':
+            case '1':
+            case '2':
+            case '3':
+            case '4':
+            case '5':
+            case '6':
+            case '7':
+            case '8':
+            case '9': {
+                if (state.search == SEARCH_ENTRY) {
                     
-                    state.number = (unsigned short)(state.number * 10U);
-                    state.number = (unsigned short)(state.number 
-                        + (byte-'0'));
-                    state.parse = PARSE_NUMBER;
-                    continue;
+                    // A number must follow a keyword. Otherise, 
+                    // syntax is illegal.
+                    break;
                     
                 }
                 
-                default:
+                state.number = (unsigned short)(state.number * 10U);
+                state.number = (unsigned short)(state.number
+                    + (byte-'0'));
+                state.parse = PARSE_NUMBER;
+                continue;
+                
             }
             
-            fclose(f);
-            return 1;
-            
+            default:
         }
+        
+        closeAsset(&file);
+        return 1;
+        
     }
     
-    c->actors = (unsigned short) actorIndex;
-    memcpy(&initialCast, c, sizeof initialCast);
-    
-    fclose(f);
+    closeAsset(&file);
     
     // The file must end with a semi-colon preceding no other lexical 
     // item.
     return state.search != SEARCH_PREPARE;
 }
 
-typedef struct {
-    char left, right;
-} sCol;
+static MirageError parseMoldInfo(sMoldDirectory *dst,
+    unsigned char const *bytes, unsigned long size,
+    int (*loadMold)(sMold *dst, unsigned char moldId,
+    char const (*name)[MOLD_NAME_CHARS], void *ctx), void *ctx);
 
-static sCol collides(unsigned int x, unsigned int y, unsigned width, 
-    sLevel const *l);
+MirageError loadMoldInfo(sMoldDirectory *dst,
+        int (*loadMold)(sMold *dst, unsigned char moldId,
+        char const (*name)[MOLD_NAME_CHARS], void *ctx), void *ctx) {
+    sAsset file;
+    MirageError code;
+    
+    if (openAsset(&file, DIR_MOLDINFO)) {
+        closeAsset(&file);
+        return MIRAGE_NO_MOLDINFO;
+        
+    }
+    
+    code = parseMoldInfo(dst, file.bytes, file.size, loadMold, ctx);
+    closeAsset(&file);
+    
+    return code;
+}
+
+static MirageError parseMoldInfo(sMoldDirectory *dst,
+        unsigned char const *bytes, unsigned long size,
+        int (*loadMold)(sMold *dst, unsigned char moldId,
+        char const (*name)[MOLD_NAME_CHARS], void *ctx), void *ctx) {
+    unsigned long byteIndex;
+    struct {
+        char name[MOLD_NAME_CHARS];
+        unsigned char braces, moldIndex, characters;
+        char foundDatum;
+        unsigned short number;
+        enum {
+            MOLDINFO_MOLDS,
+            MOLDINFO_ENTRY,
+            MOLDINFO_NAME,
+            MOLDINFO_WIDTH,
+            MOLDINFO_HEIGHT,
+            MOLDINFO_SPEED,
+            MOLDINFO_ACCEL,
+            MOLDINFO_FRAMES,
+            MOLDINFO_DATUM
+        } search;
+    } state = { { 0 }, 0, 0, 0, 0, 0, MOLDINFO_MOLDS };
+    
+    for (byteIndex = 0; byteIndex < size; ++byteIndex) {
+        char const byte = (char) bytes[byteIndex];
+        
+        switch (byte) {
+            case '{': {
+                if (state.braces >= 2U) {
+                    break;
+            
+            case '}':
+                    // Assume that the scope level is non-zero.
+                    
+                    if (state.braces-- == 1) {
+                        unsigned char temp;
+                        
+                        if (state.moldIndex-- == 0) {
+                            
+                            // The process ignores any data 
+                            // following the last mold entry.
+                            return MIRAGE_OK;
+                            
+                        }
+                        
+                        temp = state.moldIndex;
+                        
+                        // Wipe out all mold information before 
+                        // beginning to process the next mold 
+                        // entry.
+                        memset(&state, 0x00, sizeof state);
+                        state.moldIndex = temp;
+                        state.search = MOLDINFO_ENTRY;
+                        
+                    } else {
+                        static unsigned char const datum[] = {
+                            MOLDINFO_WIDTH,
+                            MOLDINFO_HEIGHT,
+                            MOLDINFO_FRAMES,
+                            MOLDINFO_NAME,
+                            MOLDINFO_SPEED,
+                            MOLDINFO_ACCEL
+                        };
+                        
+                        if (state.number < ARRAY_ELEMENTS(datum)) {
+                            state.search = datum[state.number];
+                            
+                        }
+                        
+                        state.number = 0U;
+                        state.foundDatum = 0;
+                        continue;
+                        
+                    }
+                    
+                } else {
+                    state.search = MOLDINFO_DATUM;
+                    ++state.braces;
+                    
+                }
+            }
+            // Fall-through
+            case '\n':
+            case '\t':
+            case '\r':
+            case ' ': {
+                if (!state.foundDatum) {
+                    continue;
+                    
+                } else {
+                    sMold *m = &dst->data[state.moldIndex];
+                    
+                    switch (state.search) {
+                        case MOLDINFO_MOLDS: {
+                            if (state.number == 0) {
+                                
+                                // Return because there are no 
+                                // mold entries to parse.
+                                return MIRAGE_OK;
+                                
+                            }
+                            
+                            if (state.number > MOLDS) {
+                                return MIRAGE_INVALID_MOLDINFO;
+                                
+                            }
+                            
+                            state.moldIndex = (unsigned char)
+                                (state.number - 1U);
+                            dst->molds = (unsigned char) state.number;
+                            state.search = MOLDINFO_ENTRY;
+                            break;
+                            
+                        }
+                        
+                        case MOLDINFO_NAME: {
+                            
+                            // All attributes preceding the name 
+                            // describe the dimensions of the 
+                            // mold. The loader can rely on them.
+                            if (loadMold != NULL && loadMold(m,
+                                    state.moldIndex,
+                                    (char const (*)[MOLD_NAME_CHARS])
+                                    &state.name, ctx)) {
+                                
+                                // The loader is responsible for 
+                                // reporting its own failure.
+                                return MIRAGE_LOAD_SPRITE_FAIL;
+                                
+                            }
+                            
+                            break;
+                            
+                        }
+                        
+                        case MOLDINFO_WIDTH: {
+                            m->w = (unsigned char) state.number;
+                            break;
+                            
+                        }
+                        
+                        case MOLDINFO_HEIGHT: {
+                            m->h = (unsigned char) state.number;
+                            break;
+                            
+                        }
+                        
+                        case MOLDINFO_SPEED: {
+                            m->maxSpeed = (unsigned char) state.number;
+                            break;
+                            
+                        }
+                        
+                        case MOLDINFO_ACCEL: {
+                            m->subAccel = (signed char) state.number;
+                            break;
+                            
+                        }
+                        
+                        case MOLDINFO_FRAMES: {
+                            m->frames = (unsigned char) state.number;
+                            break;
+                            
+                        }
+                        
+                        case MOLDINFO_DATUM:
+                        case MOLDINFO_ENTRY:
+                        default: {
+                            break;
+                            
+                        }
+                    }
+                    
+                }
+                state.number = 0U;
+                state.foundDatum = 0;
+                continue;
+                
+            }
+            
+            case '0':
+            case '1':
+            case '2':
+            case '3':
+            case '4':
+            case '5':
+            case '6':
+            case '7':
+            case '8':
+            case '9': {
+                state.number = (unsigned short)
+                    (state.number*10U);
+                state.number = (unsigned short)
+                    (state.number + (byte-'0'));
+                state.foundDatum = 1;
+                continue;
+                
+            }
+            
+            case 'a': case 'A':
+            case 'b': case 'B':
+            case 'c': case 'C':
+            case 'd': case 'D':
+            case 'e': case 'E':
+            case 'f': case 'F':
+            case 'g': case 'G':
+            case 'h': case 'H':
+            case 'i': case 'I':
+            case 'j': case 'J':
+            case 'k': case 'K':
+            case 'l': case 'L':
+            case 'm': case 'M':
+            case 'n': case 'N':
+            case 'o': case 'O':
+            case 'p': case 'P':
+            case 'q': case 'Q':
+            case 'r': case 'R':
+            case 's': case 'S':
+            case 't': case 'T':
+            case 'u': case 'U':
+            case 'v': case 'V':
+            case 'w': case 'W':
+            case 'x': case 'X':
+            case 'y': case 'Y':
+            case 'z': case 'Z':
+            case '_': {
+                if (state.search!=MOLDINFO_NAME
+                        || state.characters
+                        >=ARRAY_ELEMENTS(state.name) - 1) {
+                    // Include the null terminal.
+                    
+                    break;
+                    
+                }
+                state.name[state.characters++] = byte;
+                state.foundDatum = 1;
+                continue;
+                
+            }
+            
+            default:
+        }
+        
+        return MIRAGE_INVALID_MOLDINFO;
+        
+    }
+    
+    // The amount of molds and entries must match.
+    if (state.moldIndex != 0) {
+        return MIRAGE_INVALID_MOLDINFO;
+        
+    }
+    
+    return MIRAGE_OK;
+}
+
+typedef struct {
+    char left, right;
+} sCol;
+
+// The bits of the `rest` array of the cast.
+#define REST_ASLEEP 0x04U
+#define REST_LEFT 0x01U
+#define REST_RIGHT 0x02U
+
+static sCol collides(unsigned int x, unsigned int y, unsigned width, 
+    sLevel const *l);
+static char isSolid(unsigned int x, unsigned int y, sLevel const *l);
 #define collides(x, y, w, l) collides((unsigned short)(x), \
     (unsigned short)(y), (unsigned short)(w), (l))
 
-static void spawnActor(sCast *c, sActor a);
+static ACTOR_HANDLE spawnActor(sCast *c, sActor const *a);
 static void killActor(sCast *c, unsigned int id);
+static void freeDeadSlots(sCast *c);
+static void markDirty(sCast *c, unsigned int slot);
+static unsigned char landActor(sScene *s, unsigned int id);
+
+// The simulation splits the actors other than the player into ranges 
+// of slots. Each range records its commands into its own buffer, 
+// which starts at the first slot of the range in the array of 
+// commands. An actor gives at most one command per tick, so buffers 
+// never overlap.
+#define COMMAND_BUFFERS 4U
+typedef struct {
+    unsigned int first, count;
+} sCommandBuffer;
+enum {
+    COMMAND_HURT_PLAYER,
+    COMMAND_SPAWN_HUNTERS
+};
+
+static void updateRange(sScene *s, sActor const *player, unsigned int near,
+    unsigned int last, sCommandBuffer *b);
+static void updateHunters(sScene *s, sActor const *player,
+    unsigned short const *ids, unsigned int count, sCommandBuffer *b);
+static void updateNingens(sScene *s, unsigned short const *ids,
+    unsigned int count, sCommandBuffer *b);
+static void updateOthers(sScene *s, unsigned int moldId,
+    unsigned short const *ids, unsigned int count);
+static void sortCommands(sCast *c, sCommandBuffer const *b);
+static void giveCommand(sCast *c, sCommandBuffer *b, unsigned int id,
+    sActor const *a, unsigned char kind, signed char direction);
+static void applyCommands(sScene *s, sActor *player,
+    sCommandBuffer const *buffers);
+static void integrateActors(sCast *c, unsigned int lanes);
+static void applyGravity(sCast *c, unsigned char const *grounded,
+    unsigned int lanes);
+static void capVelocities(sCast *c, signed short const *maxSubX,
+    unsigned int lanes);
+static unsigned int gatherMold(sCast const *c, unsigned int moldId,
+    unsigned int first, unsigned int last, unsigned short *ids);
+static void hashSlots(sCast *c);
 
 #define ABS(X) ~~((X)>0 ? (X) : -(X))
 #define POS_TO_TILE_INDEX(X, Y, H) ~~((H)*((X)/TILE_PELS) + (Y)/TILE_PELS)
@@ -465,366 +1127,806 @@ enum {
 #define NINGEN_SPAWN_AMOUNT 80U
 #define NINGEN_DAMAGE 2
 
-int updateNpc(sScene *s, sActor *a) {
-    sMold const mold = s->md.data[a->moldId];
-    sLevel const *level = &s->level;
-    struct {
-        sCol floor, step;
-    } hitting;
-    signed char const velX = (signed char)(a->vel.subX>>8);
-    char facingRight = a->frame >= 0;
-    unsigned char absFrame = (unsigned char) 
-        (facingRight ? a->frame : ~a->frame);
+// The batched passes go over blocks of sixteen actors. The size of the 
+// cast must be a multiple of this block size.
+#define ACTOR_LANES 16U
+#define ROUND_TO_LANES(N) ~~(((N)+ACTOR_LANES-1U) / ACTOR_LANES * ACTOR_LANES)
+
+void pressKeys(sInput *input, unsigned char keys) {
+    sKey *a = &input->right;
+    unsigned int i;
     
-    // Prevent the vertical displacement of the actor to cause 
-    // arithmetic underflow when falling.
-    if (a->vel.y < 0 && -a->vel.y > a->pos.y) {
-        killActor(&s->cast, (unsigned int)(a - &s->cast.actorData.actor[0]));
-        return 1;
+    for (i = 0; i < KEYS; ++i) {
+        int const isDown = (keys >> i) & 1;
         
+        a[i].holdDur = (unsigned char)
+            (isDown ? (a[i].holdDur + isDown) : 0);
     }
     
-    a->pos.x = (unsigned short)(a->pos.x + velX);
-    a->pos.y = (unsigned short)(a->pos.y + a->vel.y);
-    hitting.floor = collides(a->pos.x, a->pos.y-1, mold.w, level);
-    if (hitting.floor.left||hitting.floor.right) {
-        a->pos.y = (unsigned short) (((a->pos.y+TILE_PELS-1)/TILE_PELS)
-            * TILE_PELS);
-        a->vel.y = 0;
+    return;
+}
+
+void updateContext(sContext *c) {
+    sScene *s = &c->scene;
+    sCast *cast = &s->cast;
+    sActor player;
+    sCommandBuffer buffers[COMMAND_BUFFERS];
+    unsigned int i, lanes, npcs, near;
+    
+    // The `updatePlayer` function can reset the whole cast. The camera 
+    // stays where it was on the previous tick until the player moves 
+    // into the cast.
+    player = updatePlayer(c);
+    freeDeadSlots(cast);
+    near = getCameraLeft(s) + VIEWPORT_WIDTH/2U - s->lod.radius;
+    
+    // Prevent the vertical displacement of any actor to cause 
+    // arithmetic underflow when falling.
+    for (i = 1; i < cast->slots; ++i) {
+        if (cast->moldId[i] != MOLD_NULL
+                && cast->velY[i] < 0 && -cast->velY[i] > cast->y[i]) {
+            killActor(cast, i);
+            
+        }
+    }
+    
+    // Actors that spawn during this tick only start updating on the 
+    // next tick. These actors take new slots, since slots that free up 
+    // during this tick only become free on the next tick.
+    npcs = cast->slots;
+    lanes = ROUND_TO_LANES(npcs);
+    // Dead slots rest on the ground, such that they never change.
+    for (i = 0; i < lanes; ++i) {
+        cast->grounded[i] = cast->moldId[i] == MOLD_NULL ? 0xFF : 0x00;
+        cast->maxSubX[i] = SHRT_MAX;
+    }
+    
+    // Update the positions of all actors before evaluating collisions.
+    integrateActors(cast, lanes);
+    for (i = 1; i < npcs; ++i) {
+        if (cast->moldId[i] != MOLD_NULL) {
+            cast->grounded[i] = cast->rest[i] & REST_ASLEEP
+                ? 0xFF : landActor(s, i);
+            
+        }
+    }
+    applyGravity(cast, cast->grounded, lanes);
+    
+    // An actor only changes its own slot while it updates, and reads 
+    // the updated copy of the player rather than the player's lane. 
+    // The ranges of slots thus do not depend on each other, and could 
+    // update on different threads. Applying the buffers in order then 
+    // gives the same result for any split.
+    for (i = 0; i < COMMAND_BUFFERS; ++i) {
+        sCommandBuffer *b = &buffers[i];
+        unsigned int const last = 1U + (npcs-1U)*(i+1U) / COMMAND_BUFFERS;
         
-    } else {
-        if (a->vel.y > -ACTOR_MAX_SPEED_Y) {
-            a->vel.y = (signed char) (a->vel.y - ACTOR_GRAVITY);
+        b->first = 1U + (npcs-1U)*i / COMMAND_BUFFERS;
+        b->count = 0;
+        updateRange(s, &player, near, last, b);
+    }
+    applyCommands(s, &player, buffers);
+    
+    // The batched passes also went over the player. Only the 
+    // `updatePlayer` function and the other actors change the player, 
+    // however.
+    setActor(cast, ACTOR_PLAYER, &player);
+    
+    // The dynamics simulator must apply speed caps at the end of the 
+    // motion update. The player keeps the largest cap, which has no 
+    // effect.
+    capVelocities(cast, cast->maxSubX, lanes);
+    
+    hashSlots(cast);
+    ++cast->tick;
+    return;
+}
+
+// Sort the actors into the buckets of the grid. Counting the actors of 
+// each bucket first lets the function place every actor directly.
+static void indexActors(sScene *s) {
+    sCast *c = &s->cast;
+    sActorGrid *g = &s->grid;
+    unsigned int i, sum, last;
+    
+    g->tick = c->tick;
+    g->stale = 0;
+    g->buckets = (unsigned int) (s->level.w*TILE_PELS) / GRID_BUCKET_PELS
+        + 1U;
+    if (g->buckets > GRID_BUCKETS) {
+        g->buckets = GRID_BUCKETS;
         
-        } else {
-            a->vel.y = -ACTOR_MAX_SPEED_Y;
+    }
+    last = g->buckets - 1U;
+    
+    // The widest mold bounds the width of all actors.
+    for (i = 0, g->maxW = 0; i < s->md.molds; ++i) {
+        if (s->md.data[i].w > g->maxW) {
+            g->maxW = s->md.data[i].w;
             
         }
-        
     }
     
-    hitting.step = collides(a->pos.x, a->pos.y+TILE_PELS-1, mold.w, level);
+    memset(g->first, 0x00, (g->buckets+1U) * sizeof*g->first);
+    for (i = 0; i < c->slots; ++i) {
+        if (c->moldId[i] != MOLD_NULL) {
+            unsigned int const bucket = c->x[i]/GRID_BUCKET_PELS;
+            
+            ++g->first[(bucket < last ? bucket : last) + 1U];
+            
+        }
+    }
     
-    switch (a->moldId) {
-        case MOLDID_HUNTER: {
-            sMold const playerMold = s->md.data
-                [s->cast.actorData.player.moldId];
-            sActor const pa = s->cast.actorData.player;
-            unsigned char seePlayer;
+    // Turn the counts into the end of each bucket. Placing an actor 
+    // then moves the end of its bucket back to its start.
+    for (i = 1, sum = 0; i <= g->buckets; ++i) {
+        sum += g->first[i];
+        g->first[i] = (unsigned short) sum;
+    }
+    for (i = c->slots; i-- > 0;) {
+        if (c->moldId[i] != MOLD_NULL) {
+            unsigned int const bucket = c->x[i]/GRID_BUCKET_PELS;
             
-            if (absFrame != ANIM_HUNTER_AIM 
-                    && absFrame != ANIM_HUNTER_SHOOT_STANDING
-                    && absFrame != ANIM_HUNTER_DEAD) {
-                if (facingRight) {
-                    if (hitting.step.right) {
-                        facingRight = 0;
-                        
-                    } else if (a->vel.subX < mold.maxSpeed << 8) {
-                        a->vel.subX = (signed short) 
-                            (a->vel.subX + mold.subAccel);
-                        
-                    }
-                    
-                } else {
-                    if (hitting.step.left) {
-                        facingRight = 1;
-                        
-                    } else if (a->vel.subX > -mold.maxSpeed << 8) {
-                        a->vel.subX = (signed short) 
-                            (a->vel.subX - mold.subAccel);
-                        
-                    }
-                    
-                }
-                
-            } else {
-                if (a->vel.subX>>8 == 0) {
-                    a->vel.subX = 0;
-                    
-                } else {
-                    if (facingRight) {
-                        a->vel.subX = (signed short) 
-                            (a->vel.subX - PLAYER_FRICTION);
-                        
-                    } else {
-                        a->vel.subX = (signed short) 
-                            (a->vel.subX + PLAYER_FRICTION);
-                        
-                    }
-                    
-                }
-                
-            }
+            c->sorted[--g->first[(bucket < last ? bucket : last) + 1U]]
+                = (unsigned short) i;
             
-            if (a->health <= 0) {
-                absFrame = ANIM_HUNTER_DEAD;
-                
-            } else if (a->pos.y >= pa.pos.y 
-                    &&a->pos.y < pa.pos.y+playerMold.h
-                    && ((facingRight && pa.pos.x+playerMold.w  
-                    >= a->pos.x+mold.w/2U)
-                    || (!facingRight && pa.pos.x < a->pos.x+mold.w/2U))
-                    && pa.health > 0) {
-                unsigned const int step = facingRight ? TILE_PELS :
-                    (unsigned int) -TILE_PELS;
-                unsigned int x, y, start, boundary;
-                
-                start = a->pos.x + mold.w/2U;
-                y = a->pos.y + mold.h/2U;
-                seePlayer = 1;
-                
-                // XXX: Add case where the boundary goes beyond the 
-                // level.
-                if (pa.pos.x >= VIEWPORT_WIDTH/2U) {
-                    boundary = start + (facingRight ? VIEWPORT_WIDTH/2U
-                        : (unsigned int) -(VIEWPORT_WIDTH/2U));
-                    
-                } else {
-                    boundary = facingRight ? VIEWPORT_WIDTH/2U : 0;
-                    
-                }
-                
-                for (x = start; 
-                        facingRight ? x<boundary : x>boundary; 
-                        x += step) {
-                    TILE t;
-                    
-                    if (facingRight) {
-                        if (x > pa.pos.x) {
-                            break;
-                            
-                        }
-                        
-                    } else {
-                        if (x < pa.pos.x) {
-                            break;
-                            
-                        }
-                        
-                    }
-                    
-                    t = level->data[POS_TO_TILE_INDEX(x, y, level->h)];
-                    
-                    // The actor is looking at solid tiles first. In this 
-                    // case, the actor can skip the attacking logic.
-                    if (t%SOLID_TILE_PERIOD == 0) {
-                        seePlayer = 0;
-                        break;
-                        
-                    }
-                }
-                
-            } else {
-                seePlayer = 0;
+        }
+    }
+    
+    // Each bucket now starts where the next bucket in the array 
+    // starts. Shift the array back to align the buckets.
+    memmove(g->first, g->first + 1, g->buckets * sizeof*g->first);
+    g->first[g->buckets] = (unsigned short) sum;
+    return;
+}
+
+unsigned int findActors(sScene *s, unsigned int x0, unsigned int x1,
+        unsigned short const **slots) {
+    sActorGrid const *g = &s->grid;
+    unsigned short *dst = s->cast.found;
+    unsigned int bucket, last, found, i;
+    
+    // Most ticks never query the grid, so the grid only sorts the 
+    // actors again once a query needs it.
+    if (g->stale || g->tick != s->cast.tick) {
+        indexActors(s);
+        
+    }
+    
+    *slots = dst;
+    if (x0 >= x1 || g->buckets == 0) {
+        return 0;
+        
+    }
+    
+    // The last bucket also holds the actors past the end of the level.
+    bucket = (x0 > g->maxW ? x0 - g->maxW : 0) / GRID_BUCKET_PELS;
+    last = (x1-1U) / GRID_BUCKET_PELS;
+    if (last >= g->buckets) {
+        last = g->buckets - 1U;
+        
+    }
+    if (bucket > last) {
+        bucket = last;
+        
+    }
+    
+    for (found = 0; bucket <= last; ++bucket) {
+        for (i = g->first[bucket]; i < g->first[bucket+1U]; ++i) {
+            unsigned short const id = s->cast.sorted[i];
+            unsigned int const x = s->cast.x[id];
+            unsigned int j;
+            
+            if (x >= x1 || x + s->md.data[s->cast.moldId[id]].w <= x0) {
+                continue;
                 
             }
             
-            // Logic that makes decisions using the enemy's 
-            // animation frame can change said animation frame.
-            if (seePlayer) {
-                if (absFrame!=ANIM_HUNTER_AIM) {
-                    absFrame = ANIM_HUNTER_AIM;
-                    a->timer = 1U;
-                    
-                }
-                
+            // Keep the identifiers in increasing order, such that 
+            // callers visit the actors in the order of the cast. 
+            // Buckets are small, so insertion is cheap.
+            for (j = found++; j > 0 && dst[j-1U] > id; --j) {
+                dst[j] = dst[j-1U];
             }
+            dst[j] = id;
+        }
+    }
+    
+    return found;
+}
+
+// Snap an actor to the ground if the pixel row below it touches a 
+// solid tile. The function returns a lane mask telling whether the 
+// actor is on the ground or not.
+static unsigned char landActor(sScene *s, unsigned int id) {
+    sCast *c = &s->cast;
+    sCol const floor = collides(c->x[id], c->y[id]-1,
+        s->md.data[c->moldId[id]].w, &s->level);
+    
+    if (floor.left||floor.right) {
+        unsigned short const y = (unsigned short)
+            (((c->y[id]+TILE_PELS-1)/TILE_PELS) * TILE_PELS);
+        
+        if (y != c->y[id]) {
+            c->y[id] = y;
+            markDirty(c, id);
             
-            switch (absFrame) {
-                case ANIM_HUNTER_WALK_NEUTRAL: {
-                    if (a->timer % ANIM_GAIT_TRANSITION_PERIOD == 0) {
-                        if (a->timer % (3U*ANIM_GAIT_TRANSITION_PERIOD) == 0) {
-                            absFrame = ANIM_HUNTER_WALK_LEFT;
-                            
-                        } else {
-                            absFrame = ANIM_HUNTER_WALK_RIGHT;
-                            
-                        }
-                        
-                    }
-                    ++a->timer;
-                    break;
-                    
-                }
+        }
+        return 0xFF;
+        
+    }
+    
+    return 0x00;
+}
+
+// Check whether a non-playable character walks into a wall. Sleeping 
+// actors reuse the result of the tick that they fell asleep on.
+static sCol probeNpc(sScene const *s, unsigned int id, sMold const *mold) {
+    sCast const *c = &s->cast;
+    sCol step;
+    
+    if (c->rest[id] & REST_ASLEEP) {
+        step.left = (char) ((c->rest[id] & REST_LEFT) != 0);
+        step.right = (char) ((c->rest[id] & REST_RIGHT) != 0);
+        return step;
+        
+    }
+    
+    return collides(c->x[id], c->y[id]+TILE_PELS-1, mold->w, &s->level);
+}
+
+// Put an actor to sleep if it stands on the ground and cannot move on 
+// the next tick. Its position then stays the same until it updates 
+// again, and so do the results of its collision checks. Landing 
+// rounds the height of an actor up to the next tile, which keeps the 
+// tile under its feet.
+static void settleNpc(sCast *c, unsigned int id, sCol step) {
+    if (c->grounded[id] && c->velY[id] == 0 && c->subX[id] >> 8 == 0) {
+        c->rest[id] = (unsigned char) (REST_ASLEEP
+            | (step.left ? REST_LEFT : 0U) | (step.right ? REST_RIGHT : 0U));
+        
+    } else {
+        c->rest[id] = 0x00;
+        
+    }
+    
+    return;
+}
+
+// Load a non-playable character and check whether it walks into a 
+// wall. The batched passes already moved the actor and applied 
+// gravity.
+static sCol beginNpc(sScene const *s, unsigned int id, sMold const *mold,
+        sActor *a) {
+    getActor(&s->cast, id, a);
+    return probeNpc(s, id, mold);
+}
+
+// Apply horizontal collision checks after the enemy updates in 
+// function of their behaviour. The batched speed caps apply to 
+// actors that do not collide.
+static void endNpc(sScene *s, unsigned int id, sMold const *mold, sActor *a,
+        sCol step) {
+    unsigned short const x = a->pos.x;
+    
+    if (step.left) {
+        a->pos.x = (unsigned short)(((a->pos.x + TILE_PELS-1) / TILE_PELS)
+            * TILE_PELS);
+        
+        a->vel.subX = 0;
+        
+    } else if (step.right) {
+        a->pos.x = (unsigned short)(((a->pos.x + mold->w-1) / TILE_PELS)
+            * TILE_PELS - mold->w-1);
+        a->vel.subX = 0;
+        
+    }
+    
+    setActor(&s->cast, id, a);
+    if (a->pos.x == x) {
+        settleNpc(&s->cast, id, step);
+        
+    }
+    
+    return;
+}
+
+// Stop a non-playable character at walls without running its 
+// behaviour.
+static void stopNpc(sScene *s, unsigned int id, sMold const *mold) {
+    sCol step;
+    
+    // Sleeping actors already stopped where they stand.
+    if (s->cast.rest[id] & REST_ASLEEP) {
+        return;
+        
+    }
+    
+    step = collides(s->cast.x[id], s->cast.y[id]+TILE_PELS-1, mold->w,
+        &s->level);
+    if (step.left || step.right) {
+        sActor actor;
+        
+        getActor(&s->cast, id, &actor);
+        endNpc(s, id, mold, &actor, step);
+        
+    } else {
+        settleNpc(&s->cast, id, step);
+        
+    }
+    
+    return;
+}
+
+// Update the live actors of a range of slots one mold at a time, such 
+// that each behaviour runs as one loop over actors of the same mold. 
+// Actors whose center is at least `near` pixels and at most twice the 
+// radius of the level of detail further are near the camera. The 
+// commands of the range then go back in the order of their slots.
+static void updateRange(sScene *s, sActor const *player, unsigned int near,
+        unsigned int last, sCommandBuffer *b) {
+    sCast *c = &s->cast;
+    unsigned short *ids = &c->byMold[b->first];
+    unsigned int const span = 2U*s->lod.radius;
+    unsigned int i, m;
+    
+    for (m = 0; m < MOLDS; ++m) {
+        sMold const *mold = &s->md.data[m];
+        unsigned int const left = near - mold->w/2U;
+        unsigned int count = gatherMold(c, m, b->first, last, ids);
+        signed short const maxSubX = (signed short) (mold->maxSpeed << 8);
+        unsigned int awake;
+        
+        // Far actors that do not take their turn on this tick leave the 
+        // batch. The unsigned difference also wraps around for actors 
+        // to the left of the camera.
+        for (i = 0, awake = 0; i < count; ++i) {
+            unsigned int const id = ids[i];
+            
+            c->maxSubX[id] = maxSubX;
+            if (c->x[id] - left <= span
+                    || ((c->tick + id) & (s->lod.divisor - 1U)) == 0) {
+                ids[awake++] = (unsigned short) id;
                 
-                case ANIM_HUNTER_WALK_RIGHT:
-                case ANIM_HUNTER_WALK_LEFT: {
-                    if (a->timer % ANIM_GAIT_TRANSITION_PERIOD == 0) {
-                        absFrame = ANIM_HUNTER_WALK_NEUTRAL;
-                        
-                    }
-                    ++a->timer;
-                    break;
+            } else {
+                stopNpc(s, id, mold);
+                
+            }
+        }
+        
+        count = awake;
+        if (count == 0) {
+            continue;
+            
+        }
+        
+        switch (m) {
+            case MOLDID_HUNTER: {
+                updateHunters(s, player, ids, count, b);
+                break;
+                
+            }
+            
+            case MOLDID_NINGEN: {
+                updateNingens(s, ids, count, b);
+                break;
+                
+            }
+            
+            case MOLDID_PLAYER:
+            default: {
+                updateOthers(s, m, ids, count);
+                
+            }
+        }
+    }
+    
+    sortCommands(c, b);
+    return;
+}
+
+static void updateHunters(sScene *s, sActor const *player,
+        unsigned short const *ids, unsigned int count, sCommandBuffer *b) {
+    sMold const mold = s->md.data[MOLDID_HUNTER];
+    sMold const playerMold = s->md.data[player->moldId];
+    sLevel const *level = &s->level;
+    sActor const *p = player;
+    unsigned int i;
+    
+    for (i = 0; i < count; ++i) {
+        unsigned int const id = ids[i];
+        sActor actor;
+        sActor *a = &actor;
+        sCol const step = beginNpc(s, id, &mold, a);
+        char facingRight = a->frame >= 0;
+        unsigned char absFrame = (unsigned char) (facingRight
+            ? a->frame : ~a->frame);
+        unsigned char seePlayer = 0;
+        
+        if (absFrame != ANIM_HUNTER_AIM
+                && absFrame != ANIM_HUNTER_SHOOT_STANDING
+                && absFrame != ANIM_HUNTER_DEAD) {
+            if (facingRight) {
+                if (step.right) {
+                    facingRight = 0;
+                    
+                } else if (a->vel.subX < mold.maxSpeed << 8) {
+                    a->vel.subX = (signed short)
+                        (a->vel.subX + mold.subAccel);
                     
                 }
                 
-                case ANIM_HUNTER_SHOOT_STANDING:
-                case ANIM_HUNTER_AIM: {
-                    if (((a->timer == HUNTER_AIM_PERIOD) && pa.health > 0)
-                            || (pa.pos.x > a->pos.x
-                            && pa.pos.x < a->pos.x+mold.w)
-                            || (pa.pos.x+playerMold.w > a->pos.x
-                            && pa.pos.x+playerMold.w < a->pos.x+mold.w)) {
-                        
-                        // Only damage the player if the player is 
-                        // within sight.
-                        if (seePlayer) {
-                            sActor *p = &s->cast.actorData.player;
-                            p->health = (signed char)
-                                (s->cast.actorData.player.health 
-                                - (signed char) HUNTER_DAMAGE);
-                            if (pa.pos.x > a->pos.x) {
-                                p->frame = ANIM_PLAYER_HURT;
-                                p->vel.subX = (signed short)
-                                    (p->vel.subX + HUNTER_KNOCKBACK);
-                                
-                            } else {
-                                p->frame = ~ANIM_PLAYER_HURT;
-                                p->vel.subX = (signed short)
-                                    (p->vel.subX - HUNTER_KNOCKBACK);
-                                
-                            }
-                            
-                            // Do not stack the vertical component of 
-                            // the knockback.
-                            p->vel.y = +6;
-                            
-                            if (a->timer >= HUNTER_AIM_PERIOD) {
-                                absFrame = ANIM_HUNTER_SHOOT_STANDING;
-                            
-                            }
-                                
-                            
-                        }
-                        
-                    } else if (a->timer > HUNTER_AIM_PERIOD) {
-                        absFrame = ANIM_HUNTER_AIM;
-                        if (a->timer > HUNTER_AIM_PERIOD
-                                + ANIM_SHOOT_FLASH_TRANSITION
-                                + HUNTER_RECOIL_PERIOD) {
-                            a->timer = 0;
-                            absFrame = ANIM_HUNTER_WALK_NEUTRAL;
-                            
-                        }
-                        
-                    }
+            } else {
+                if (step.left) {
+                    facingRight = 1;
                     
-                    ++a->timer;
-                    break;
+                } else if (a->vel.subX > -mold.maxSpeed << 8) {
+                    a->vel.subX = (signed short)
+                        (a->vel.subX - mold.subAccel);
                     
                 }
                 
-                case ANIM_HUNTER_DEAD:
-                default:
             }
             
-            break;
+        } else {
+            if (a->vel.subX>>8 == 0) {
+                a->vel.subX = 0;
+                
+            } else {
+                if (facingRight) {
+                    a->vel.subX = (signed short)
+                        (a->vel.subX - PLAYER_FRICTION);
+                    
+                } else {
+                    a->vel.subX = (signed short)
+                        (a->vel.subX + PLAYER_FRICTION);
+                    
+                }
+                
+            }
             
         }
         
-        case MOLDID_NINGEN: {
-            if (a->timer % NINGEN_SPAWN_PERIOD == 0) {
-                unsigned int iterations, i;
-                unsigned int const step = mold.w/NINGEN_SPAWN_AMOUNT,
-                    maxActors = (unsigned int) 
-                    ARRAY_ELEMENTS(s->cast.actorData.actor);
+        if (a->health <= 0) {
+            absFrame = ANIM_HUNTER_DEAD;
+            
+        } else if (a->pos.y >= p->pos.y
+                &&a->pos.y < p->pos.y+playerMold.h
+                && ((facingRight && p->pos.x+playerMold.w
+                >= a->pos.x+mold.w/2U)
+                || (!facingRight && p->pos.x < a->pos.x+mold.w/2U))
+                && p->health > 0) {
+            unsigned int start, row, boundary, span, reach;
+            
+            start = a->pos.x + mold.w/2U;
+            row = (a->pos.y + mold.h/2U) / TILE_PELS;
+            
+            // XXX: Add case where the boundary goes beyond the 
+            // level.
+            if (p->pos.x >= VIEWPORT_WIDTH/2U) {
+                boundary = start + (facingRight ? VIEWPORT_WIDTH/2U
+                    : (unsigned int) -(VIEWPORT_WIDTH/2U));
                 
-                if (s->cast.actors == maxActors) {
-                    unsigned int kills;
-                    for (i = 0, kills = 0; 
-                            i < maxActors && kills < NINGEN_SPAWN_AMOUNT;
-                            ++i) {
-                        if (s->cast.actorData.actor[i].moldId 
-                                == MOLDID_HUNTER) {
-                            killActor(&s->cast, i);
-                            ++kills;
-                            
-                        }
+            } else {
+                boundary = facingRight ? VIEWPORT_WIDTH/2U : 0;
+                
+            }
+            
+            // The actor looks at one tile after another, from its 
+            // center towards the player. It stops at the boundary 
+            // or past the player, whichever comes first. The actor 
+            // sees the player if none of these tiles are solid.
+            if (facingRight) {
+                span = boundary > start
+                    ? (boundary-start + TILE_PELS-1U) / TILE_PELS : 0;
+                reach = p->pos.x >= start
+                    ? (p->pos.x-start) / TILE_PELS + 1U : 0;
+                
+            } else {
+                span = start > boundary
+                    ? (start-boundary + TILE_PELS-1U) / TILE_PELS : 0;
+                reach = start >= p->pos.x
+                    ? (start-p->pos.x) / TILE_PELS + 1U : 0;
+                
+            }
+            
+            if (row < level->h) {
+                unsigned short const *clear = facingRight
+                    ? level->clearRight : level->clearLeft;
+                
+                seePlayer = (span < reach ? span : reach)
+                    <= clear[row*level->w + start/TILE_PELS];
+                
+            } else {
+                seePlayer = 0;
+                
+            }
+            
+        } else {
+            seePlayer = 0;
+            
+        }
+        
+        // Logic that makes decisions using the enemy's 
+        // animation frame can change said animation frame.
+        if (seePlayer) {
+            if (absFrame!=ANIM_HUNTER_AIM) {
+                absFrame = ANIM_HUNTER_AIM;
+                a->timer = 1U;
+                
+            }
+            
+        }
+        
+        switch (absFrame) {
+            case ANIM_HUNTER_WALK_NEUTRAL: {
+                if (a->timer % ANIM_GAIT_TRANSITION_PERIOD == 0) {
+                    if (a->timer % (3U*ANIM_GAIT_TRANSITION_PERIOD) == 0) {
+                        absFrame = ANIM_HUNTER_WALK_LEFT;
+                        
+                    } else {
+                        absFrame = ANIM_HUNTER_WALK_RIGHT;
+                        
                     }
-                    iterations = kills;
-                    
-                } else if (s->cast.actors+NINGEN_SPAWN_AMOUNT > maxActors) {
-                    iterations = (unsigned int) (maxActors - s->cast.actors);
                     
-                    
-                } else {
-                    iterations = NINGEN_SPAWN_AMOUNT;
+                }
+                ++a->timer;
+                break;
+                
+            }
+            
+            case ANIM_HUNTER_WALK_RIGHT:
+            case ANIM_HUNTER_WALK_LEFT: {
+                if (a->timer % ANIM_GAIT_TRANSITION_PERIOD == 0) {
+                    absFrame = ANIM_HUNTER_WALK_NEUTRAL;
                     
                 }
+                ++a->timer;
+                break;
+                
+            }
+            
+            case ANIM_HUNTER_SHOOT_STANDING:
+            case ANIM_HUNTER_AIM: {
+                if (((a->timer == HUNTER_AIM_PERIOD) && p->health > 0)
+                        || (p->pos.x > a->pos.x
+                        && p->pos.x < a->pos.x+mold.w)
+                        || (p->pos.x+playerMold.w > a->pos.x
+                        && p->pos.x+playerMold.w < a->pos.x+mold.w)) {
+                    
+                    // Only damage the player if the player is 
+                    // within sight.
+                    if (seePlayer) {
+                        giveCommand(&s->cast, b, id, a,
+                            COMMAND_HURT_PLAYER,
+                            p->pos.x > a->pos.x ? +1 : -1);
+                        
+                        if (a->timer >= HUNTER_AIM_PERIOD) {
+                            absFrame = ANIM_HUNTER_SHOOT_STANDING;
+                            
+                        }
+                        
+                        
+                    }
                     
-                for (i = 0; i < iterations; ++i) {
-                    sActor npc;
-                    npc.pos.x = (unsigned short) (a->pos.x + i*step);
-                    npc.pos.y = (unsigned short) a->pos.y;
-                    npc.moldId = MOLDID_HUNTER;
-                    npc.frame = i%2 == 0 ?  ANIM_HUNTER_WALK_NEUTRAL
-                        : ~ANIM_HUNTER_WALK_NEUTRAL;
-                    npc.health = +1;
-                    npc.timer = 0;
-                    npc.vel.subX = 0;
-                    npc.vel.y = 0;
+                } else if (a->timer > HUNTER_AIM_PERIOD) {
+                    absFrame = ANIM_HUNTER_AIM;
+                    if (a->timer > HUNTER_AIM_PERIOD
+                            + ANIM_SHOOT_FLASH_TRANSITION
+                            + HUNTER_RECOIL_PERIOD) {
+                        a->timer = 0;
+                        absFrame = ANIM_HUNTER_WALK_NEUTRAL;
+                        
+                    }
                     
-                    spawnActor(&s->cast, npc);
                 }
                 
+                ++a->timer;
+                break;
+                
             }
             
-            ++a->timer;
-            break;
+            case ANIM_HUNTER_DEAD:
+            default:
+        }
+        
+        if (facingRight) {
+            a->frame = (signed char) absFrame;
+            
+        } else {
+            a->frame = (signed char) ~absFrame;
             
         }
         
-        case MOLDID_PLAYER:
-        default:
+        endNpc(s, id, &mold, a, step);
     }
     
-    // Apply horizontal collision checks after the enemy updates in 
-    // function of their behaviour.
-    if (hitting.step.left) {
-        a->pos.x = (unsigned short)(((a->pos.x + TILE_PELS-1) / TILE_PELS)
-            * TILE_PELS);
-        
-        a->vel.subX = 0;
-        
-    } else if (hitting.step.right) {
-        a->pos.x = (unsigned short)(((a->pos.x + mold.w-1) / TILE_PELS)
-            * TILE_PELS - mold.w-1);
-        a->vel.subX = 0;
+    return;
+}
+
+static void updateNingens(sScene *s, unsigned short const *ids,
+        unsigned int count, sCommandBuffer *b) {
+    sMold const mold = s->md.data[MOLDID_NINGEN];
+    unsigned int i;
+    
+    for (i = 0; i < count; ++i) {
+        unsigned int const id = ids[i];
+        sActor actor;
+        sActor *a = &actor;
+        sCol const step = beginNpc(s, id, &mold, a);
         
-    } else {
-        if (a->vel.subX > mold.maxSpeed << 8) {
-            a->vel.subX = (signed short) (mold.maxSpeed << 8);
-            
-        } else if (a->vel.subX < -mold.maxSpeed << 8) {
-            a->vel.subX = (signed short) (-mold.maxSpeed << 8);
+        if (a->timer % NINGEN_SPAWN_PERIOD == 0) {
+            giveCommand(&s->cast, b, id, a, COMMAND_SPAWN_HUNTERS, 0);
             
         }
-    
+        
+        ++a->timer;
+        endNpc(s, id, &mold, a, step);
     }
     
-    if (facingRight) {
-        a->frame = (signed char) absFrame;
+    return;
+}
+
+// Actors of the other molds have no behaviour of their own.
+static void updateOthers(sScene *s, unsigned int moldId,
+        unsigned short const *ids, unsigned int count) {
+    sMold const mold = s->md.data[moldId];
+    unsigned int i;
+    
+    for (i = 0; i < count; ++i) {
+        sActor actor;
+        sCol const step = beginNpc(s, ids[i], &mold, &actor);
         
-    } else {
-        a->frame = (signed char) ~absFrame;
+        endNpc(s, ids[i], &mold, &actor, step);
+    }
+    
+    return;
+}
+
+// Put the commands of a buffer back in the order of their slots. The 
+// buffer holds one increasing run of slots per mold, and actors 
+// rarely give commands, so an insertion sort does little work.
+static void sortCommands(sCast *c, sCommandBuffer const *b) {
+    sCommand *cmds = &c->commands[b->first];
+    unsigned int i, j;
+    
+    for (i = 1; i < b->count; ++i) {
+        sCommand const cmd = cmds[i];
         
+        for (j = i; j > 0 && cmds[j-1U].slot > cmd.slot; --j) {
+            cmds[j] = cmds[j-1U];
+        }
+        cmds[j] = cmd;
     }
     
-    return 0;
+    return;
+}
+
+static void giveCommand(sCast *c, sCommandBuffer *b, unsigned int id,
+        sActor const *a, unsigned char kind, signed char direction) {
+    sCommand *cmd = &c->commands[b->first + b->count++];
+    
+    cmd->slot = (unsigned short) id;
+    cmd->x = a->pos.x;
+    cmd->y = a->pos.y;
+    cmd->kind = kind;
+    cmd->direction = direction;
+    return;
+}
+
+// Apply the commands of all buffers in the order of the slots that 
+// gave them. Spawning can move the arrays of the cast. Actors that 
+// died earlier in this function take back their commands, since they 
+// would not have updated in a serial order. Hunters only see the 
+// player as it was before the other actors updated, so the player 
+// also ignores damage after dying within the same tick.
+static void applyCommands(sScene *s, sActor *player,
+        sCommandBuffer const *buffers) {
+    sCast *c = &s->cast;
+    unsigned int i, j;
+    
+    for (i = 0; i < COMMAND_BUFFERS; ++i) {
+        for (j = 0; j < buffers[i].count; ++j) {
+            sCommand const cmd = c->commands[buffers[i].first + j];
+            
+            if (c->moldId[cmd.slot] == MOLD_NULL
+                    || (cmd.kind == COMMAND_HURT_PLAYER
+                    && player->health <= 0)) {
+                continue;
+                
+            }
+            
+            switch (cmd.kind) {
+                case COMMAND_HURT_PLAYER: {
+                    player->health = (signed char)
+                        (player->health - (signed char) HUNTER_DAMAGE);
+                    if (cmd.direction > 0) {
+                        player->frame = ANIM_PLAYER_HURT;
+                        player->vel.subX = (signed short)
+                            (player->vel.subX + HUNTER_KNOCKBACK);
+                        
+                    } else {
+                        player->frame = ~ANIM_PLAYER_HURT;
+                        player->vel.subX = (signed short)
+                            (player->vel.subX - HUNTER_KNOCKBACK);
+                        
+                    }
+                    
+                    // Do not stack the vertical component of the 
+                    // knockback.
+                    player->vel.y = +6;
+                    break;
+                    
+                }
+                
+                case COMMAND_SPAWN_HUNTERS: {
+                    unsigned int iterations, k;
+                    unsigned int const step = s->md.data[c->moldId[cmd.slot]].w
+                        / NINGEN_SPAWN_AMOUNT, maxActors = c->limit;
+                    
+                    // Recycle the oldest hunters when the cast is full.
+                    if (c->live == maxActors) {
+                        unsigned int kills;
+                        for (kills = 0; kills < NINGEN_SPAWN_AMOUNT
+                                && c->oldest[MOLDID_HUNTER]
+                                != ACTOR_SLOT_NONE; ++kills) {
+                            killActor(c, c->oldest[MOLDID_HUNTER]);
+                        }
+                        iterations = kills;
+                        
+                    } else if (c->live+NINGEN_SPAWN_AMOUNT > maxActors) {
+                        iterations = (unsigned int) (maxActors - c->live);
+                        
+                    } else {
+                        iterations = NINGEN_SPAWN_AMOUNT;
+                        
+                    }
+                    
+                    for (k = 0; k < iterations; ++k) {
+                        sActor npc;
+                        npc.pos.x = (unsigned short) (cmd.x + k*step);
+                        npc.pos.y = cmd.y;
+                        npc.moldId = MOLDID_HUNTER;
+                        npc.frame = k%2 == 0 ?  ANIM_HUNTER_WALK_NEUTRAL
+                            : ~ANIM_HUNTER_WALK_NEUTRAL;
+                        npc.health = +1;
+                        npc.timer = 0;
+                        npc.vel.subX = 0;
+                        npc.vel.y = 0;
+                        
+                        if (spawnActor(c, &npc) == ACTOR_HANDLE_NONE) {
+                            break;
+                            
+                        }
+                    }
+                    break;
+                    
+                }
+                
+                default:
+            }
+        }
+    }
+    
+    return;
 }
 
 sActor updatePlayer(sContext *c) {
-    sActor p = c->scene.cast.actorData.player;
-    sMold const mold = c->scene.md.data[p.moldId];
+    sActor p;
+    sMold mold;
     sLevel const level = c->scene.level;
     sInput input;
-    sCoord const prev = p.pos;
+    sCoord prev;
     signed short maxSpeed;
     struct {
         sCol floor, step, bottom, ceil;
     } hitting;
     unsigned char absFrame;
     
+    getActor(&c->scene.cast, ACTOR_PLAYER, &p);
+    mold = c->scene.md.data[p.moldId];
+    prev = p.pos;
+    
     // Update the vertical position of the player, whether the player 
     // will collide or not. The logic following these updates will 
     // rely on these new coordinates to make decisions.
@@ -835,8 +1937,8 @@ sActor updatePlayer(sContext *c) {
     // out-of-bounds tilemap indices.
     if (p.vel.y < 0
             && p.pos.y > (unsigned short)(p.pos.y - p.vel.y)) {
-        c->scene.cast = initialCast;
-        p = initialCast.actorData.player;
+        loadCheckpoint(&c->scene, c->scene.checkpoints.count - 1U);
+        getActor(&c->scene.cast, ACTOR_PLAYER, &p);
         
     }
     
@@ -888,8 +1990,8 @@ sActor updatePlayer(sContext *c) {
     } else {
         if (absFrame == ANIM_PLAYER_DEAD) {
             if (p.timer++ == PLAYER_RESPAWN_FRAMES) {
-                c->scene.cast = initialCast;
-                p = initialCast.actorData.player;
+                loadCheckpoint(&c->scene, c->scene.checkpoints.count - 1U);
+                getActor(&c->scene.cast, ACTOR_PLAYER, &p);
                 
             }
             
@@ -1133,16 +2235,15 @@ sActor updatePlayer(sContext *c) {
     
     // Evaluate left and right collisions after potentially snapping 
     // the player to the ground.
-    hitting.bottom.left = level.data[POS_TO_TILE_INDEX(p.pos.x, p.pos.y, 
-        level.h)] % SOLID_TILE_PERIOD == 0;
+    hitting.bottom.left = isSolid(p.pos.x, p.pos.y, &level);
     if (hitting.bottom.left) {
         p.vel.subX = 0;
         p.pos.x = (unsigned short)(((p.pos.x + TILE_PELS-1)/TILE_PELS)
             *TILE_PELS);
         
     } else {
-        hitting.bottom.right = level.data[POS_TO_TILE_INDEX(p.pos.x+mold.w-1, 
-            p.pos.y, level.h)] % SOLID_TILE_PERIOD == 0;
+        hitting.bottom.right = isSolid((unsigned int)
+            (p.pos.x+mold.w-1), p.pos.y, &level);
         if (hitting.bottom.right) {
             p.vel.subX = 0;
             
@@ -1196,23 +2297,1557 @@ sActor updatePlayer(sContext *c) {
 #undef collides
 static sCol collides(unsigned int x, unsigned int y, unsigned int width, 
         sLevel const *l) {
-    sCol const col = {
-        l->data[POS_TO_TILE_INDEX(x, y, l->h)] 
-            % SOLID_TILE_PERIOD == 0,
-        l->data[POS_TO_TILE_INDEX(x + width-1, y, l->h)]
-            % SOLID_TILE_PERIOD == 0 || x+width-1 > TILE_PELS*l->w
-    };
+    sCol col;
+    unsigned int const right = (unsigned int) (TILE_PELS*l->w);
+    
+    // Check the boundaries of the level first to stay within the 
+    // bitmap. Columns past the last one are solid. Rows above the 
+    // level are empty, like the row below the lowest one, which wraps 
+    // around to the top.
+    if (y >= TILE_PELS*l->h) {
+        col.left = (char) (x >= right);
+        col.right = (char) (x+width-1 >= right);
+        return col;
+        
+    }
     
+    col.left = (char) (x >= right || isSolid(x, y, l));
+    col.right = (char) (x+width-1 >= right || isSolid(x + width-1, y, l));
     return col;
 }
 
-static void spawnActor(sCast *c, sActor a) {
-    c->actorData.actor[c->actors++] = a;
-    return;
+// Look up the bit of the tile at the given pixel coordinates in the 
+// solidity bitmap.
+static char isSolid(unsigned int x, unsigned int y, sLevel const *l) {
+    unsigned int const row = y/TILE_PELS;
+    
+    return (char) (l->solid[x/TILE_PELS*l->solidStride
+        + row/SOLID_WORD_BITS] >> row%SOLID_WORD_BITS & 1U);
+}
+
+// The first bit of a dirty byte tells whether the slot changed since 
+// the latest checkpoint. The third bit tells whether an attribute of 
+// the slot other than its motion changed since the latest recorded 
+// tick of the rewind buffer. The motion of a slot is its position, its 
+// velocity, its frame and its timer.
+#define DIRTY_CHECKPOINT 0x01U
+#define DIRTY_REWIND 0x04U
+
+static void markDirty(sCast *c, unsigned int slot) {
+    c->dirty[slot] = 0xFF;
+    return;
+}
+
+// Mark a slot dirty, given that only its motion changed.
+static void markMoved(sCast *c, unsigned int slot) {
+    c->dirty[slot] = (unsigned char)
+        (c->dirty[slot] | (0xFFU & ~DIRTY_REWIND));
+    return;
+}
+
+// Clear the bits of the dirty bytes of some slots, except for `keep`.
+static void cleanSlots(sCast *c, unsigned int slots, unsigned int keep) {
+    unsigned int slot;
+    
+    for (slot = 0; slot < slots; ++slot) {
+        c->dirty[slot] = (unsigned char) (c->dirty[slot] & keep);
+    }
+    return;
+}
+
+// Both functions copy an actor attribute by attribute. Returning the 
+// struct by value instead makes the compiler assemble it in memory and 
+// read it back as a whole, which stalls the store buffer.
+void getActor(sCast const *c, unsigned int id, sActor *dst) {
+    dst->pos.x = c->x[id];
+    dst->pos.y = c->y[id];
+    dst->vel.subX = c->subX[id];
+    dst->vel.y = c->velY[id];
+    dst->moldId = c->moldId[id];
+    dst->frame = c->frame[id];
+    dst->health = c->health[id];
+    dst->timer = c->timer[id];
+    return;
+}
+
+void setActor(sCast *c, unsigned int id, sActor const *src) {
+    int const other = c->moldId[id] != src->moldId
+        || c->health[id] != src->health;
+    
+    c->x[id] = src->pos.x;
+    c->y[id] = src->pos.y;
+    c->subX[id] = src->vel.subX;
+    c->velY[id] = src->vel.y;
+    c->moldId[id] = src->moldId;
+    c->frame[id] = src->frame;
+    c->health[id] = src->health;
+    c->timer[id] = src->timer;
+    c->rest[id] = 0x00;
+    if (other) {
+        markDirty(c, id);
+        
+    } else {
+        markMoved(c, id);
+        
+    }
+    return;
+}
+
+// Take a free slot for a new actor. The function returns 
+// `ACTOR_SLOT_NONE` if the cast cannot grow anymore.
+static unsigned int takeSlot(sCast *c) {
+    unsigned int slot = c->freeSlot;
+    
+    if (slot != ACTOR_SLOT_NONE) {
+        c->freeSlot = c->nextFree[slot];
+        return slot;
+        
+    }
+    
+    if (c->slots == c->capacity) {
+        unsigned int capacity = c->capacity ? 2U*c->capacity : ACTOR_LANES;
+        
+        if (capacity > ACTOR_SLOTS_MAX) {
+            capacity = ACTOR_SLOTS_MAX;
+            
+        }
+        if (capacity == c->capacity || growCast(c, capacity)) {
+            return ACTOR_SLOT_NONE;
+            
+        }
+        
+    }
+    
+    return c->slots++;
+}
+
+// Append an actor to the list of actors of its mold.
+static void linkActor(sCast *c, unsigned int slot) {
+    unsigned char const moldId = c->moldId[slot];
+    unsigned short const youngest = c->youngest[moldId];
+    
+    c->older[slot] = youngest;
+    c->younger[slot] = ACTOR_SLOT_NONE;
+    if (youngest == ACTOR_SLOT_NONE) {
+        c->oldest[moldId] = (unsigned short) slot;
+        
+    } else {
+        c->younger[youngest] = (unsigned short) slot;
+        markDirty(c, youngest);
+        
+    }
+    c->youngest[moldId] = (unsigned short) slot;
+    markDirty(c, slot);
+    return;
+}
+
+static ACTOR_HANDLE spawnActor(sCast *c, sActor const *a) {
+    unsigned int slot;
+    
+    if (c->live >= c->limit || a->moldId >= MOLDS
+            || (slot = takeSlot(c)) == ACTOR_SLOT_NONE) {
+        return ACTOR_HANDLE_NONE;
+        
+    }
+    
+    setActor(c, slot, a);
+    linkActor(c, slot);
+    ++c->live;
+    return getActorHandle(c, slot);
 }
 
 static void killActor(sCast *c, unsigned int id) {
-    c->actorData.actor[id] = c->actorData.actor[c->actors - 1];
-    c->actorData.actor[--c->actors].moldId = MOLD_NULL;
+    unsigned char const moldId = c->moldId[id];
+    unsigned short const older = c->older[id], younger = c->younger[id];
+    
+    if (older == ACTOR_SLOT_NONE) {
+        c->oldest[moldId] = younger;
+        
+    } else {
+        c->younger[older] = younger;
+        markDirty(c, older);
+        
+    }
+    if (younger == ACTOR_SLOT_NONE) {
+        c->youngest[moldId] = older;
+        
+    } else {
+        c->older[younger] = older;
+        markDirty(c, younger);
+        
+    }
+    
+    // Dead slots do not move.
+    c->moldId[id] = MOLD_NULL;
+    c->subX[id] = 0;
+    c->velY[id] = 0;
+    c->generation[id] = (unsigned short) (c->generation[id] + 1U);
+    --c->live;
+    
+    // Keep the slot aside until the next tick.
+    c->nextFree[id] = ACTOR_SLOT_NONE;
+    if (c->deadSlot == ACTOR_SLOT_NONE) {
+        c->deadSlot = (unsigned short) id;
+        
+    } else {
+        c->nextFree[c->deadTail] = (unsigned short) id;
+        markDirty(c, c->deadTail);
+        
+    }
+    c->deadTail = (unsigned short) id;
+    markDirty(c, id);
+    return;
+}
+
+static void freeDeadSlots(sCast *c) {
+    if (c->deadSlot != ACTOR_SLOT_NONE) {
+        c->nextFree[c->deadTail] = c->freeSlot;
+        markDirty(c, c->deadTail);
+        c->freeSlot = c->deadSlot;
+        c->deadSlot = ACTOR_SLOT_NONE;
+        
+    }
+    return;
+}
+
+unsigned int findActorSlot(sCast const *c, ACTOR_HANDLE h) {
+    unsigned int const slot = h & 0xFFFFU;
+    
+    if (slot >= c->slots || c->moldId[slot] == MOLD_NULL
+            || c->generation[slot] != h >> 16) {
+        return ACTOR_SLOT_NONE;
+        
+    }
+    
+    return slot;
+}
+
+ACTOR_HANDLE getActorHandle(sCast const *c, unsigned int slot) {
+    return (ACTOR_HANDLE) c->generation[slot] << 16 | slot;
+}
+
+// Lay out the arrays of the cast in one allocation. Arrays of wider 
+// elements come first to keep every array aligned.
+#define CAST_SLOT_BYTES ~~(sizeof(unsigned int) + sizeof(sCommand) \
+    + 11U*sizeof(unsigned short) + 8U)
+#define PLACE_COLUMN(C, COLUMN, AT, N) \
+    ((C)->COLUMN = (void *) (AT), (AT) += (N) * sizeof*(C)->COLUMN)
+static int growCast(sCast *c, unsigned int capacity) {
+    sCast grown;
+    unsigned char *block, *at;
+    unsigned int const n = c->slots;
+    
+    block = malloc((size_t) capacity * CAST_SLOT_BYTES);
+    if (block == NULL) {
+        return 1;
+        
+    }
+    
+    grown = *c;
+    at = block;
+    PLACE_COLUMN(&grown, hashes, at, capacity);
+    PLACE_COLUMN(&grown, commands, at, capacity);
+    PLACE_COLUMN(&grown, x, at, capacity);
+    PLACE_COLUMN(&grown, y, at, capacity);
+    PLACE_COLUMN(&grown, subX, at, capacity);
+    PLACE_COLUMN(&grown, generation, at, capacity);
+    PLACE_COLUMN(&grown, older, at, capacity);
+    PLACE_COLUMN(&grown, younger, at, capacity);
+    PLACE_COLUMN(&grown, nextFree, at, capacity);
+    PLACE_COLUMN(&grown, maxSubX, at, capacity);
+    PLACE_COLUMN(&grown, sorted, at, capacity);
+    PLACE_COLUMN(&grown, found, at, capacity);
+    PLACE_COLUMN(&grown, byMold, at, capacity);
+    PLACE_COLUMN(&grown, velY, at, capacity);
+    PLACE_COLUMN(&grown, moldId, at, capacity);
+    PLACE_COLUMN(&grown, frame, at, capacity);
+    PLACE_COLUMN(&grown, health, at, capacity);
+    PLACE_COLUMN(&grown, timer, at, capacity);
+    PLACE_COLUMN(&grown, rest, at, capacity);
+    PLACE_COLUMN(&grown, grounded, at, capacity);
+    PLACE_COLUMN(&grown, dirty, at, capacity);
+    
+    // The batched passes go over slots past the last slot. The 
+    // attributes of these slots must have some value.
+    memset(block, 0x00, (size_t) capacity * CAST_SLOT_BYTES);
+    memset(grown.moldId, MOLD_NULL, capacity);
+    if (n != 0) {
+        memcpy(grown.hashes, c->hashes, n * sizeof*c->hashes);
+        memcpy(grown.x, c->x, n * sizeof*c->x);
+        memcpy(grown.y, c->y, n * sizeof*c->y);
+        memcpy(grown.subX, c->subX, n * sizeof*c->subX);
+        memcpy(grown.generation, c->generation, n * sizeof*c->generation);
+        memcpy(grown.older, c->older, n * sizeof*c->older);
+        memcpy(grown.younger, c->younger, n * sizeof*c->younger);
+        memcpy(grown.nextFree, c->nextFree, n * sizeof*c->nextFree);
+        memcpy(grown.velY, c->velY, n * sizeof*c->velY);
+        memcpy(grown.moldId, c->moldId, n * sizeof*c->moldId);
+        memcpy(grown.frame, c->frame, n * sizeof*c->frame);
+        memcpy(grown.health, c->health, n * sizeof*c->health);
+        memcpy(grown.timer, c->timer, n * sizeof*c->timer);
+        memcpy(grown.rest, c->rest, n * sizeof*c->rest);
+        
+        // The cast can grow in the middle of a tick.
+        memcpy(grown.maxSubX, c->maxSubX, c->capacity * sizeof*c->maxSubX);
+        memcpy(grown.grounded, c->grounded,
+            c->capacity * sizeof*c->grounded);
+        memcpy(grown.dirty, c->dirty, c->capacity * sizeof*c->dirty);
+        memcpy(grown.commands, c->commands,
+            c->capacity * sizeof*c->commands);
+        
+    }
+    
+    grown.capacity = capacity;
+    freeCast(c);
+    *c = grown;
+    return 0;
+}
+
+int copyCast(sCast *dst, sCast const *src) {
+    unsigned int const n = src->slots;
+    
+    if (dst->capacity < n && growCast(dst, src->capacity)) {
+        return 1;
+        
+    }
+    
+    memcpy(dst->x, src->x, n * sizeof*src->x);
+    memcpy(dst->y, src->y, n * sizeof*src->y);
+    memcpy(dst->subX, src->subX, n * sizeof*src->subX);
+    memcpy(dst->generation, src->generation, n * sizeof*src->generation);
+    memcpy(dst->older, src->older, n * sizeof*src->older);
+    memcpy(dst->younger, src->younger, n * sizeof*src->younger);
+    memcpy(dst->nextFree, src->nextFree, n * sizeof*src->nextFree);
+    memcpy(dst->velY, src->velY, n * sizeof*src->velY);
+    memcpy(dst->moldId, src->moldId, n * sizeof*src->moldId);
+    memcpy(dst->frame, src->frame, n * sizeof*src->frame);
+    memcpy(dst->health, src->health, n * sizeof*src->health);
+    memcpy(dst->timer, src->timer, n * sizeof*src->timer);
+    memcpy(dst->rest, src->rest, n * sizeof*src->rest);
+    
+    // Slots past the end of the source cast are dead. All slots of the 
+    // destination count as changed.
+    if (dst->slots > n) {
+        memset(dst->moldId + n, MOLD_NULL, dst->slots - n);
+        
+    }
+    memset(dst->dirty, 0xFF, ROUND_TO_LANES(dst->slots > n ? dst->slots : n));
+    
+    copyCastHead(dst, src);
+    return 0;
+}
+
+// Copy the attributes of a cast that do not belong to any slot.
+static void copyCastHead(sCast *dst, sCast const *src) {
+    memcpy(dst->oldest, src->oldest, sizeof dst->oldest);
+    memcpy(dst->youngest, src->youngest, sizeof dst->youngest);
+    dst->freeSlot = src->freeSlot;
+    dst->deadSlot = src->deadSlot;
+    dst->deadTail = src->deadTail;
+    dst->slots = src->slots;
+    dst->live = src->live;
+    dst->limit = src->limit;
+    dst->tick = src->tick;
+    return;
+}
+
+static void recordSlot(sSlotRecord *dst, sCast const *c, unsigned int slot) {
+    getActor(c, slot, &dst->actor);
+    dst->slot = (unsigned short) slot;
+    dst->generation = c->generation[slot];
+    dst->older = c->older[slot];
+    dst->younger = c->younger[slot];
+    dst->nextFree = c->nextFree[slot];
+    return;
+}
+
+// Put a slot back into the state of a record. A slot that changed 
+// hands since the record, or that dies again, gets a new generation. 
+// This invalidates the handles to its current actor. The generations 
+// of slots only ever increase.
+static void restoreSlot(sCast *c, sSlotRecord const *src) {
+    unsigned int const slot = src->slot;
+    
+    if (c->generation[slot] != src->generation
+            || (src->actor.moldId == MOLD_NULL
+            && c->moldId[slot] != MOLD_NULL)) {
+        c->generation[slot] = (unsigned short) (c->generation[slot] + 1U);
+        
+    }
+    setActor(c, slot, &src->actor);
+    c->older[slot] = src->older;
+    c->younger[slot] = src->younger;
+    c->nextFree[slot] = src->nextFree;
+    markDirty(c, slot);
+    return;
+}
+
+static int initCheckpoints(sScene *s) {
+    sCheckpoints *cp = &s->checkpoints;
+    
+    cp->count = 0;
+    cp->recordCount = 0;
+    if (copyCast(&cp->base, &s->cast)) {
+        return 1;
+        
+    }
+    
+    hashSlots(&s->cast);
+    cleanSlots(&s->cast, ROUND_TO_LANES(s->cast.slots), DIRTY_REWIND);
+    cp->marks[0].first = 0;
+    cp->count = 1;
+    return 0;
+}
+
+int saveCheckpoint(sScene *s) {
+    sCast *c = &s->cast;
+    sCheckpoints *cp = &s->checkpoints;
+    sCast *base = &cp->base;
+    unsigned int const lanes = ROUND_TO_LANES(c->slots);
+    unsigned int slot, records;
+    
+    if (cp->count == CHECKPOINTS_MAX) {
+        return 1;
+        
+    }
+    
+    // Make room for the slots that changed first, such that the 
+    // function can no longer fail while it updates the checkpoints.
+    for (slot = 0, records = cp->recordCount; slot < lanes; ++slot) {
+        records += c->dirty[slot] & DIRTY_CHECKPOINT;
+    }
+    if (records > cp->recordCapacity) {
+        unsigned int capacity = cp->recordCapacity
+            ? cp->recordCapacity : ACTOR_LANES;
+        sSlotRecord *grown;
+        
+        while (capacity < records) {
+            capacity *= 2U;
+        }
+        grown = realloc(cp->records, capacity * sizeof*grown);
+        if (grown == NULL) {
+            return 1;
+            
+        }
+        cp->records = grown;
+        cp->recordCapacity = capacity;
+        
+    }
+    if (base->capacity < c->slots && growCast(base, c->capacity)) {
+        return 1;
+        
+    }
+    
+    // The base cast becomes the new checkpoint. The latest checkpoint 
+    // keeps the slots that are about to change in the base cast.
+    copyCastHead(&cp->marks[cp->count-1U].head, base);
+    for (slot = 0; slot < lanes; ++slot) {
+        if (c->dirty[slot] & DIRTY_CHECKPOINT) {
+            sSlotRecord now;
+            
+            recordSlot(&cp->records[cp->recordCount++], base, slot);
+            recordSlot(&now, c, slot);
+            restoreSlot(base, &now);
+            base->generation[slot] = now.generation;
+            
+        }
+    }
+    hashSlots(c);
+    cleanSlots(c, lanes, DIRTY_REWIND);
+    copyCastHead(base, c);
+    
+    cp->marks[cp->count++].first = cp->recordCount;
+    return 0;
+}
+
+// Kill the slots past the end of a cast that were in use.
+static void truncateCast(sCast *c, unsigned int slots) {
+    unsigned int slot;
+    
+    for (slot = slots; slot < c->slots; ++slot) {
+        if (c->moldId[slot] != MOLD_NULL) {
+            c->moldId[slot] = MOLD_NULL;
+            c->generation[slot] = (unsigned short)
+                (c->generation[slot] + 1U);
+            markDirty(c, slot);
+            
+        }
+    }
+    return;
+}
+
+void loadCheckpoint(sScene *s, unsigned int checkpoint) {
+    sCast *c = &s->cast;
+    sCheckpoints *cp = &s->checkpoints;
+    sCast *base = &cp->base;
+    unsigned int const lanes = ROUND_TO_LANES(
+        c->slots > base->slots ? c->slots : base->slots);
+    unsigned int slot, i;
+    
+    if (checkpoint >= cp->count) {
+        return;
+        
+    }
+    
+    // Restore the latest checkpoint from the base cast.
+    for (slot = 0; slot < base->slots; ++slot) {
+        if (c->dirty[slot] & DIRTY_CHECKPOINT) {
+            sSlotRecord then;
+            
+            recordSlot(&then, base, slot);
+            restoreSlot(c, &then);
+            base->generation[slot] = c->generation[slot];
+            
+        }
+    }
+    truncateCast(c, base->slots);
+    copyCastHead(c, base);
+    
+    // Undo the changes between earlier checkpoints in both casts, from 
+    // the latest one to the requested one.
+    for (i = cp->recordCount; i-- > cp->marks[checkpoint].first;) {
+        restoreSlot(c, &cp->records[i]);
+        restoreSlot(base, &cp->records[i]);
+        base->generation[cp->records[i].slot]
+            = c->generation[cp->records[i].slot];
+    }
+    if (checkpoint + 1U < cp->count) {
+        sCast const *head = &cp->marks[checkpoint].head;
+        
+        truncateCast(c, head->slots);
+        truncateCast(base, head->slots);
+        copyCastHead(c, head);
+        copyCastHead(base, head);
+        cp->recordCount = cp->marks[checkpoint].first;
+        cp->count = checkpoint + 1U;
+        
+    }
+    
+    hashSlots(c);
+    cleanSlots(c, lanes, DIRTY_REWIND);
+    s->grid.stale = 1;
+    return;
+}
+
+void freeCheckpoints(sCheckpoints *cp) {
+    freeCast(&cp->base);
+    free(cp->records);
+    cp->records = NULL;
+    cp->recordCount = cp->recordCapacity = 0;
+    cp->count = 0;
+    return;
+}
+
+#define HASH_MASK 0xFFFFFFFFUL
+#define HASH_SEED 0x9E3779B1UL
+#define HASH_PRIME 0x85EBCA6BUL
+#define HASH_FINAL 0xC2B2AE35UL
+#define HASH_MIX(H, WORD) ((H) = ((H) ^ (WORD)) * HASH_PRIME & HASH_MASK, \
+    (H) ^= (H) >> 15)
+
+// Mix the attributes of a slot into 32 bits, which gives the same 
+// value on every platform. The generation of a slot does not count, 
+// since rewinding changes it.
+static unsigned long hashSlot(sCast const *c, unsigned int slot) {
+    unsigned long h = (slot + 1UL) * HASH_SEED & HASH_MASK;
+    
+    if (c->moldId[slot] == MOLD_NULL) {
+        return 0;
+        
+    }
+    
+    HASH_MIX(h, c->x[slot] | (unsigned long) c->y[slot] << 16);
+    HASH_MIX(h, (unsigned short) c->subX[slot]
+        | (unsigned long) (unsigned char) c->velY[slot] << 16
+        | (unsigned long) c->moldId[slot] << 24);
+    HASH_MIX(h, (unsigned char) c->frame[slot]
+        | (unsigned long) (unsigned char) c->health[slot] << 8
+        | (unsigned long) c->timer[slot] << 16);
+    h = h * HASH_FINAL & HASH_MASK;
+    return h ^ h >> 16;
+}
+
+// The hash of a cast is the sum of the hashes of its slots, such that 
+// updating one slot does not involve any other slot.
+unsigned long hashCast(sCast const *c) {
+    unsigned long h = 0;
+    unsigned int slot;
+    
+    for (slot = 0; slot < c->slots; ++slot) {
+        h += hashSlot(c, slot);
+    }
+    
+    return h & HASH_MASK;
+}
+
+unsigned long hashContext(sContext const *c) {
+    sKey const *a = &c->input.right;
+    unsigned long h = c->scene.cast.hash;
+    unsigned int i;
+    
+    for (i = 0; i < KEYS; ++i) {
+        HASH_MIX(h, a[i].holdDur | (unsigned long) i << 8);
+    }
+    
+    return h;
+}
+
+void freeCast(sCast *c) {
+    
+    // The first array starts the allocation of the cast.
+    free(c->hashes);
+    c->hashes = NULL;
+    c->capacity = 0;
+    return;
+}
+
+#include <emmintrin.h>
+
+// The batched passes below treat every actor as one lane of a vector. 
+// They process all lanes up to a multiple of the lane block size, 
+// including unused actor slots. Updating the attributes of unused 
+// slots is harmless since spawning an actor overwrites them.
+
+// Expand tiles from two per byte, high nibble first, to one per byte. 
+// The function reads whole vectors of bytes while they lie within the 
+// packed tiles, then unpacks the remaining tiles one by one. An odd 
+// amount of tiles leaves the low nibble of the last byte unused.
+static void unpackTiles(TILE *dst, unsigned char const *src,
+        unsigned long tiles) {
+    __m128i const nibble = _mm_set1_epi8(0x0F);
+    unsigned long i;
+    
+    for (i = 0; tiles - i >= 2U*sizeof(__m128i); i += 2U*sizeof(__m128i)) {
+        __m128i const packed = _mm_loadu_si128((__m128i const*)&src[i/2U]);
+        __m128i const high = _mm_and_si128(_mm_srli_epi16(packed, 4), nibble);
+        __m128i const low = _mm_and_si128(packed, nibble);
+        
+        _mm_storeu_si128((__m128i*)&dst[i], _mm_unpacklo_epi8(high, low));
+        _mm_storeu_si128((__m128i*)&dst[i + sizeof(__m128i)],
+            _mm_unpackhi_epi8(high, low));
+    }
+    
+    for (; i < tiles; ++i) {
+        dst[i] = (TILE) (src[i/2U] >> (~i%2U*4U) & 0x0F);
+    }
+    
+    return;
+}
+
+// Pack tiles from one per byte to two per byte, high nibble first. Each 
+// pair of tiles forms a 16-bit lane, whose low byte becomes the packed 
+// byte after shifting the first tile up and the second tile down.
+static void packTiles(unsigned char *dst, TILE const *src,
+        unsigned long tiles) {
+    __m128i const low = _mm_set1_epi16(0x00FF);
+    unsigned long i;
+    
+    for (i = 0; tiles - i >= 2U*sizeof(__m128i); i += 2U*sizeof(__m128i)) {
+        __m128i const first = _mm_loadu_si128((__m128i const*)&src[i]);
+        __m128i const second = _mm_loadu_si128(
+            (__m128i const*)&src[i + sizeof(__m128i)]);
+        
+        _mm_storeu_si128((__m128i*)&dst[i/2U], _mm_packus_epi16(
+            _mm_and_si128(_mm_or_si128(_mm_slli_epi16(first, 4),
+            _mm_srli_epi16(first, 8)), low),
+            _mm_and_si128(_mm_or_si128(_mm_slli_epi16(second, 4),
+            _mm_srli_epi16(second, 8)), low)));
+    }
+    
+    for (; i < tiles; i += 2U) {
+        dst[i/2U] = (unsigned char) (src[i] << 4
+            | (i + 1U < tiles ? src[i + 1U] : 0));
+    }
+    
+    return;
+}
+
+// Mark the actors of a lane block dirty, given a mask of the lanes 
+// that did not change. The batched passes only move actors, like the 
+// `markMoved` function.
+static void markLanes(sCast *c, unsigned int first, __m128i unchanged) {
+    __m128i const dirty = _mm_loadu_si128((__m128i*)&c->dirty[first]);
+    
+    _mm_storeu_si128((__m128i*)&c->dirty[first],
+        _mm_or_si128(dirty, _mm_andnot_si128(unchanged,
+        _mm_set1_epi8((char) (0xFFU & ~DIRTY_REWIND)))));
+    return;
+}
+
+// Write the slots of the actors of a mold within a range of slots to 
+// an array, in increasing order, and return how many there are. The 
+// function compares whole lane blocks and drops the lanes outside of 
+// the range.
+static unsigned int gatherMold(sCast const *c, unsigned int moldId,
+        unsigned int first, unsigned int last, unsigned short *ids) {
+    __m128i const mold = _mm_set1_epi8((char) moldId);
+    unsigned int i, count = 0;
+    
+    for (i = first / ACTOR_LANES * ACTOR_LANES; i < last; i += ACTOR_LANES) {
+        unsigned int lane, bits = (unsigned int) _mm_movemask_epi8(
+            _mm_cmpeq_epi8(_mm_loadu_si128((__m128i const*)&c->moldId[i]),
+            mold));
+        
+        if (i < first) {
+            bits &= 0xFFFFU << (first - i);
+            
+        }
+        
+        if (last - i < ACTOR_LANES) {
+            bits &= (1U << (last - i)) - 1U;
+            
+        }
+        
+        // Most blocks only hold actors of a single mold.
+        if (bits == 0xFFFFU) {
+            __m128i const low = _mm_add_epi16(_mm_set1_epi16((short) i),
+                _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7));
+            
+            _mm_storeu_si128((__m128i*)&ids[count], low);
+            _mm_storeu_si128((__m128i*)&ids[count + 8U],
+                _mm_add_epi16(low, _mm_set1_epi16(8)));
+            count += ACTOR_LANES;
+            continue;
+            
+        }
+        
+        // The loop writes every lane without branching, and moves on 
+        // past the lanes that match. It stops at the last lane that 
+        // matches, so it never writes past the slots that it returns.
+        for (lane = i; bits != 0; ++lane, bits >>= 1) {
+            ids[count] = (unsigned short) lane;
+            count += bits & 1U;
+        }
+    }
+    
+    return count;
+}
+
+static void integrateActors(sCast *c, unsigned int lanes) {
+    unsigned int i;
+    
+    for (i = 0; i < lanes; i += ACTOR_LANES) {
+        __m128i const velY = _mm_loadu_si128((__m128i*)&c->velY[i]);
+        
+        // Sign-extend the vertical velocities to sixteen bits. The 
+        // eight most significant bits of the horizontal 
+        // sub-velocities alter the actors' positions.
+        __m128i const velYLow = _mm_srai_epi16(
+            _mm_unpacklo_epi8(velY, velY), 8);
+        __m128i const velYHigh = _mm_srai_epi16(
+            _mm_unpackhi_epi8(velY, velY), 8);
+        __m128i const velXLow = _mm_srai_epi16(
+            _mm_loadu_si128((__m128i*)&c->subX[i]), 8);
+        __m128i const velXHigh = _mm_srai_epi16(
+            _mm_loadu_si128((__m128i*)&c->subX[i + 8U]), 8);
+        
+        _mm_storeu_si128((__m128i*)&c->x[i], _mm_add_epi16(
+            _mm_loadu_si128((__m128i*)&c->x[i]), velXLow));
+        _mm_storeu_si128((__m128i*)&c->x[i + 8U], _mm_add_epi16(
+            _mm_loadu_si128((__m128i*)&c->x[i + 8U]), velXHigh));
+        _mm_storeu_si128((__m128i*)&c->y[i], _mm_add_epi16(
+            _mm_loadu_si128((__m128i*)&c->y[i]), velYLow));
+        _mm_storeu_si128((__m128i*)&c->y[i + 8U], _mm_add_epi16(
+            _mm_loadu_si128((__m128i*)&c->y[i + 8U]), velYHigh));
+        
+        // Saturation keeps the packed velocities apart from zero.
+        markLanes(c, i, _mm_cmpeq_epi8(_mm_setzero_si128(), _mm_or_si128(
+            velY, _mm_packs_epi16(velXLow, velXHigh))));
+    }
+    
+    return;
+}
+
+static void applyGravity(sCast *c, unsigned char const *grounded,
+        unsigned int lanes) {
+    __m128i const gravity = _mm_set1_epi8(ACTOR_GRAVITY);
+    
+    // SSE2 lacks a maximum for signed bytes. Flipping the sign bit of 
+    // both operands maps their signed order onto the unsigned order.
+    __m128i const sign = _mm_set1_epi8((char) 0x80);
+    __m128i const maxFall = _mm_xor_si128(sign,
+        _mm_set1_epi8(-ACTOR_MAX_SPEED_Y));
+    unsigned int i;
+    
+    for (i = 0; i < lanes; i += ACTOR_LANES) {
+        __m128i const before = _mm_loadu_si128((__m128i*)&c->velY[i]);
+        __m128i velY;
+        
+        velY = _mm_subs_epi8(before, gravity);
+        velY = _mm_xor_si128(sign,
+            _mm_max_epu8(_mm_xor_si128(sign, velY), maxFall));
+        
+        // Actors on the ground stop falling.
+        velY = _mm_andnot_si128(
+            _mm_loadu_si128((__m128i const*)&grounded[i]), velY);
+        _mm_storeu_si128((__m128i*)&c->velY[i], velY);
+        markLanes(c, i, _mm_cmpeq_epi8(before, velY));
+    }
+    
+    return;
+}
+
+static void capVelocities(sCast *c, signed short const *maxSubX,
+        unsigned int lanes) {
+    __m128i const zero = _mm_setzero_si128();
+    __m128i unchanged = zero;
+    unsigned int i;
+    
+    for (i = 0; i < lanes; i += ACTOR_LANES/2U) {
+        __m128i const cap = _mm_loadu_si128((__m128i const*)&maxSubX[i]);
+        __m128i const before = _mm_loadu_si128((__m128i*)&c->subX[i]);
+        __m128i subX;
+        
+        subX = _mm_min_epi16(before, cap);
+        subX = _mm_max_epi16(subX, _mm_sub_epi16(zero, cap));
+        _mm_storeu_si128((__m128i*)&c->subX[i], subX);
+        
+        // Each iteration covers half a lane block. The second half 
+        // marks the whole block.
+        if (i % ACTOR_LANES == 0) {
+            unchanged = _mm_cmpeq_epi16(before, subX);
+            
+        } else {
+            markLanes(c, i - ACTOR_LANES/2U, _mm_packs_epi16(unchanged,
+                _mm_cmpeq_epi16(before, subX)));
+            
+        }
+    }
+    
+    return;
+}
+
+// The second bit of a dirty byte tells whether the slot changed since 
+// the latest update of its hash. Marking a slot dirty sets every bit.
+#define DIRTY_HASH 0x02U
+
+// Multiply four 32-bit lanes by the same constant. SSE2 only multiplies 
+// two lanes at a time.
+static __m128i mulLanes(__m128i a, __m128i k) {
+    __m128i const even = _mm_mul_epu32(a, k);
+    __m128i const odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), k);
+    
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)),
+        _mm_shuffle_epi32(odd, _MM_SHUFFLE(0,0,2,0)));
+}
+
+// Mix the attributes of four slots the same way as the `hashSlot` 
+// function, given the words that this function builds.
+static __m128i hashLanes(__m128i seed, __m128i w0, __m128i w1,
+        __m128i w2) {
+    __m128i const prime = _mm_set1_epi32((int) HASH_PRIME);
+    __m128i h = seed;
+    
+    h = mulLanes(_mm_xor_si128(h, w0), prime);
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    h = mulLanes(_mm_xor_si128(h, w1), prime);
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    h = mulLanes(_mm_xor_si128(h, w2), prime);
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    h = mulLanes(h, _mm_set1_epi32((int) HASH_FINAL));
+    return _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+}
+
+// Hash the slots that changed again and update the sum of the hashes. 
+// The function goes over every slot that the cast can hold, since 
+// slots past the last slot can die without the cast noticing. Blocks 
+// of lanes without any change cost one comparison.
+static void hashSlots(sCast *c) {
+    __m128i const flag = _mm_set1_epi8((char) DIRTY_HASH);
+    __m128i const zero = _mm_setzero_si128();
+    __m128i const step = _mm_set1_epi32((int) (4UL*HASH_SEED & HASH_MASK));
+    __m128i sum = zero;
+    unsigned int i, half, quarter;
+    
+    for (i = 0; i < c->capacity; i += ACTOR_LANES) {
+        __m128i const dirty = _mm_loadu_si128((__m128i*)&c->dirty[i]);
+        __m128i changed = _mm_cmpeq_epi8(_mm_and_si128(dirty, flag), flag);
+        __m128i moldId, dead, velY, frame, health, timer, seed;
+        
+        if (_mm_movemask_epi8(changed) == 0) {
+            continue;
+            
+        }
+        
+        moldId = _mm_loadu_si128((__m128i*)&c->moldId[i]);
+        dead = _mm_cmpeq_epi8(moldId, _mm_set1_epi8((char) MOLD_NULL));
+        velY = _mm_loadu_si128((__m128i*)&c->velY[i]);
+        frame = _mm_loadu_si128((__m128i*)&c->frame[i]);
+        health = _mm_loadu_si128((__m128i*)&c->health[i]);
+        timer = _mm_loadu_si128((__m128i*)&c->timer[i]);
+        seed = _mm_add_epi32(_mm_set1_epi32((int) (i*HASH_SEED & HASH_MASK)),
+            mulLanes(_mm_set_epi32(4, 3, 2, 1),
+            _mm_set1_epi32((int) HASH_SEED)));
+        
+        // Widen the attributes of eight lanes at a time to 16 bits, 
+        // then of four lanes at a time to 32 bits. Shifting the 
+        // vectors brings the next lanes to the bottom.
+        for (half = 0; half < ACTOR_LANES; half += 8U) {
+            __m128i x = _mm_loadu_si128((__m128i*)&c->x[i + half]);
+            __m128i y = _mm_loadu_si128((__m128i*)&c->y[i + half]);
+            __m128i subX = _mm_loadu_si128((__m128i*)&c->subX[i + half]);
+            __m128i vm = _mm_unpacklo_epi8(velY, moldId);
+            __m128i fh = _mm_unpacklo_epi8(frame, health);
+            __m128i tz = _mm_unpacklo_epi8(timer, zero);
+            __m128i d = _mm_unpacklo_epi8(dead, dead);
+            __m128i ch = _mm_unpacklo_epi8(changed, changed);
+            
+            for (quarter = 0; quarter < 8U; quarter += 4U) {
+                __m128i *at = (__m128i*)&c->hashes[i + half + quarter];
+                __m128i const old = _mm_loadu_si128(at);
+                __m128i h;
+                
+                h = hashLanes(seed, _mm_unpacklo_epi16(x, y),
+                    _mm_unpacklo_epi16(subX, vm),
+                    _mm_unpacklo_epi16(fh, tz));
+                h = _mm_andnot_si128(_mm_unpacklo_epi16(d, d), h);
+                h = _mm_xor_si128(old, _mm_and_si128(_mm_xor_si128(old, h),
+                    _mm_unpacklo_epi16(ch, ch)));
+                sum = _mm_add_epi32(sum, _mm_sub_epi32(h, old));
+                _mm_storeu_si128(at, h);
+                
+                seed = _mm_add_epi32(seed, step);
+                x = _mm_srli_si128(x, 8);
+                y = _mm_srli_si128(y, 8);
+                subX = _mm_srli_si128(subX, 8);
+                vm = _mm_srli_si128(vm, 8);
+                fh = _mm_srli_si128(fh, 8);
+                tz = _mm_srli_si128(tz, 8);
+                d = _mm_srli_si128(d, 8);
+                ch = _mm_srli_si128(ch, 8);
+            }
+            
+            velY = _mm_srli_si128(velY, 8);
+            moldId = _mm_srli_si128(moldId, 8);
+            frame = _mm_srli_si128(frame, 8);
+            health = _mm_srli_si128(health, 8);
+            timer = _mm_srli_si128(timer, 8);
+            dead = _mm_srli_si128(dead, 8);
+            changed = _mm_srli_si128(changed, 8);
+        }
+        
+        _mm_storeu_si128((__m128i*)&c->dirty[i], _mm_andnot_si128(flag, dirty));
+    }
+    
+    // Add up the four lanes of the sum.
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1,0,3,2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2,3,0,1)));
+    c->hash = (c->hash + (unsigned int) _mm_cvtsi128_si32(sum)) & HASH_MASK;
+    return;
+}
+
+// The rewind buffer compares the arrays of attributes of the cast and 
+// the shadow cast one block of lanes at a time. Arrays of 16-bit 
+// attributes come first.
+#define REWIND_COLUMNS 12U
+#define REWIND_WIDE_COLUMNS 7U
+
+// The arrays of the motion of the actors.
+#define REWIND_MOTION_COLUMNS ~~(1U << 0 | 1U << 1 | 1U << 2 | 1U << 7 \
+    | 1U << 9 | 1U << 11)
+
+// The changed lanes of an array store their former values in one of 
+// these ways: 
+// - one difference from the current values, shared by all lanes, 
+// - one difference per lane of the block, that fits in a signed byte, 
+// - the whole former value of each lane. 
+// The differences wrap around like the attributes do.
+enum {
+    REWIND_SAME,
+    REWIND_SMALL,
+    REWIND_WHOLE
+};
+
+// A tick starts with a mask of the arrays that changed. Each of these 
+// arrays takes a bit per block that tells whether the block changed, 
+// and each changed block takes at most a mask of lanes, a way of 
+// storing and room for two vectors of values.
+#define REWIND_MAP_BYTES(LANES) ~~(((LANES)/ACTOR_LANES + 7U) / 8U)
+#define REWIND_BLOCK_BYTES ~~(3U + 2U*ACTOR_LANES)
+
+static void listColumns(sCast const *c, void *columns[REWIND_COLUMNS]) {
+    columns[0] = c->x;
+    columns[1] = c->y;
+    columns[2] = c->subX;
+    columns[3] = c->generation;
+    columns[4] = c->older;
+    columns[5] = c->younger;
+    columns[6] = c->nextFree;
+    columns[7] = c->velY;
+    columns[8] = c->moldId;
+    columns[9] = c->frame;
+    columns[10] = c->health;
+    columns[11] = c->timer;
+    return;
+}
+
+static int initRewind(sScene *s) {
+    sRewind *r = &s->rewind;
+    
+    r->firstTick = r->tickCount = r->end = 0;
+    r->ticks = malloc(REWIND_TICKS * sizeof*r->ticks);
+    r->bytes = malloc(REWIND_BYTES);
+    if (r->ticks == NULL || r->bytes == NULL
+            || copyCast(&r->shadow, &s->cast)) {
+        return 1;
+        
+    }
+    
+    return 0;
+}
+
+// Return a byte for each lane of a block, that has all its bits set 
+// if the lane holds the same value in both arrays.
+static __m128i compareLanes(void const *a, void const *b, int wide) {
+    __m128i const *const u = a;
+    __m128i const *const v = b;
+    
+    if (wide) {
+        return _mm_packs_epi16(
+            _mm_cmpeq_epi16(_mm_loadu_si128(u), _mm_loadu_si128(v)),
+            _mm_cmpeq_epi16(_mm_loadu_si128(u + 1), _mm_loadu_si128(v + 1)));
+        
+    }
+    
+    return _mm_cmpeq_epi8(_mm_loadu_si128(u), _mm_loadu_si128(v));
+}
+
+static void copyLanes(void *dst, void const *src, unsigned int width) {
+    __m128i *const u = dst;
+    __m128i const *const v = src;
+    
+    _mm_storeu_si128(u, _mm_loadu_si128(v));
+    if (width == 2U) {
+        _mm_storeu_si128(u + 1, _mm_loadu_si128(v + 1));
+        
+    }
+    return;
+}
+
+// Move the bytes of the changed lanes of two vectors to their first 
+// bytes, in order, and return how many lanes changed. Each lane moves 
+// by the amount of unchanged lanes before it, in steps of one, two, 
+// four and eight lanes. Moving lanes never land on lanes that stay.
+#define PACK_STEP(LOW, HIGH, SHIFTS, STEP) do { \
+    __m128i const step = _mm_set1_epi8(STEP); \
+    __m128i const moving = _mm_cmpeq_epi8(_mm_and_si128(SHIFTS, step), \
+        step); \
+    \
+    (LOW) = _mm_or_si128(_mm_andnot_si128(moving, LOW), \
+        _mm_srli_si128(_mm_and_si128(moving, LOW), STEP)); \
+    (HIGH) = _mm_or_si128(_mm_andnot_si128(moving, HIGH), \
+        _mm_srli_si128(_mm_and_si128(moving, HIGH), STEP)); \
+    (SHIFTS) = _mm_or_si128(_mm_andnot_si128(moving, SHIFTS), \
+        _mm_srli_si128(_mm_and_si128(moving, SHIFTS), STEP)); \
+} while (0)
+static unsigned int packLanes(__m128i *low, __m128i *high,
+        __m128i unchanged) {
+    __m128i shifts = _mm_and_si128(unchanged, _mm_set1_epi8(1));
+    unsigned int count;
+    
+    shifts = _mm_add_epi8(shifts, _mm_slli_si128(shifts, 1));
+    shifts = _mm_add_epi8(shifts, _mm_slli_si128(shifts, 2));
+    shifts = _mm_add_epi8(shifts, _mm_slli_si128(shifts, 4));
+    shifts = _mm_add_epi8(shifts, _mm_slli_si128(shifts, 8));
+    count = ACTOR_LANES - ((unsigned int) _mm_extract_epi16(shifts, 7) >> 8);
+    
+    shifts = _mm_andnot_si128(unchanged, shifts);
+    *low = _mm_andnot_si128(unchanged, *low);
+    *high = _mm_andnot_si128(unchanged, *high);
+    PACK_STEP(*low, *high, shifts, 1);
+    PACK_STEP(*low, *high, shifts, 2);
+    PACK_STEP(*low, *high, shifts, 4);
+    PACK_STEP(*low, *high, shifts, 8);
+    return count;
+}
+
+// Append the former values of the changed lanes of a block of an 
+// array, in the shortest way that holds them. Whole values store their 
+// low bytes first, then their high bytes. Blocks of an array tend to 
+// share the same difference, so the function first tries the latest 
+// shared difference of the array.
+static unsigned char *encodeLanes(unsigned char *out,
+        void const *former, void const *now, __m128i unchanged,
+        unsigned int width, unsigned char *guess) {
+    __m128i const *const u = former;
+    __m128i const *const v = now;
+    unsigned int const changed = ~(unsigned int)
+        _mm_movemask_epi8(unchanged) & 0xFFFFU;
+    __m128i const bytes = _mm_set1_epi16(0xFF);
+    __m128i delta, same, lowest, highest, low, high;
+    unsigned int fit, count;
+    
+    *out++ = (unsigned char) (changed & 0xFFU);
+    *out++ = (unsigned char) (changed >> 8);
+    if (width == 2U) {
+        __m128i const first = _mm_sub_epi16(_mm_loadu_si128(u),
+            _mm_loadu_si128(v));
+        __m128i const second = _mm_sub_epi16(_mm_loadu_si128(u + 1),
+            _mm_loadu_si128(v + 1));
+        __m128i const shared = _mm_set1_epi16((short) (signed char) *guess);
+        
+        same = _mm_packs_epi16(_mm_cmpeq_epi16(first, shared),
+            _mm_cmpeq_epi16(second, shared));
+        if (_mm_movemask_epi8(_mm_or_si128(same, unchanged)) == 0xFFFF) {
+            *out++ = REWIND_SAME;
+            *out++ = *guess;
+            return out;
+            
+        }
+        
+        // A difference fits in a byte if narrowing it with saturation 
+        // keeps its value.
+        delta = _mm_packs_epi16(first, second);
+        fit = (unsigned int) _mm_movemask_epi8(_mm_packs_epi16(
+            _mm_cmpeq_epi16(first, _mm_srai_epi16(
+            _mm_unpacklo_epi8(delta, delta), 8)),
+            _mm_cmpeq_epi16(second, _mm_srai_epi16(
+            _mm_unpackhi_epi8(delta, delta), 8))));
+        
+    } else {
+        delta = _mm_sub_epi8(_mm_loadu_si128(u), _mm_loadu_si128(v));
+        same = _mm_cmpeq_epi8(delta, _mm_set1_epi8((char) *guess));
+        if (_mm_movemask_epi8(_mm_or_si128(same, unchanged)) == 0xFFFF) {
+            *out++ = REWIND_SAME;
+            *out++ = *guess;
+            return out;
+            
+        }
+        fit = 0xFFFFU;
+        
+    }
+    
+    // The changed lanes share their difference if its lowest and 
+    // highest values match. The unchanged lanes take values that never 
+    // win either comparison.
+    lowest = _mm_or_si128(delta, unchanged);
+    highest = _mm_andnot_si128(unchanged, delta);
+    lowest = _mm_min_epu8(lowest, _mm_srli_si128(lowest, 8));
+    highest = _mm_max_epu8(highest, _mm_srli_si128(highest, 8));
+    lowest = _mm_min_epu8(lowest, _mm_srli_si128(lowest, 4));
+    highest = _mm_max_epu8(highest, _mm_srli_si128(highest, 4));
+    lowest = _mm_min_epu8(lowest, _mm_srli_si128(lowest, 2));
+    highest = _mm_max_epu8(highest, _mm_srli_si128(highest, 2));
+    lowest = _mm_min_epu8(lowest, _mm_srli_si128(lowest, 1));
+    highest = _mm_max_epu8(highest, _mm_srli_si128(highest, 1));
+    if ((fit & changed) == changed && ((_mm_cvtsi128_si32(lowest)
+            ^ _mm_cvtsi128_si32(highest)) & 0xFF) == 0) {
+        *guess = (unsigned char) (_mm_cvtsi128_si32(highest) & 0xFF);
+        *out++ = REWIND_SAME;
+        *out++ = *guess;
+        return out;
+        
+    }
+    
+    // Small differences keep a byte for every lane, since packing them 
+    // costs more time than the bytes that it saves.
+    if ((fit & changed) == changed) {
+        *out++ = REWIND_SMALL;
+        _mm_storeu_si128((__m128i*)out, _mm_andnot_si128(unchanged, delta));
+        return out + ACTOR_LANES;
+        
+    }
+    
+    *out++ = REWIND_WHOLE;
+    low = _mm_packus_epi16(_mm_and_si128(_mm_loadu_si128(u), bytes),
+        _mm_and_si128(_mm_loadu_si128(u + 1), bytes));
+    high = _mm_packus_epi16(_mm_srli_epi16(_mm_loadu_si128(u), 8),
+        _mm_srli_epi16(_mm_loadu_si128(u + 1), 8));
+    
+    // Both vectors go out whole. The worst case of the tick has room for 
+    // the bytes past the values.
+    count = packLanes(&low, &high, unchanged);
+    _mm_storeu_si128((__m128i*)out, low);
+    _mm_storeu_si128((__m128i*)(out + count), high);
+    return out + 2U*count;
+}
+
+// Append the former values of a block of an array that differ from the 
+// cast, then bring the block of the shadow cast up to date. The 
+// function appends nothing if the block did not change.
+static unsigned char *recordLanes(unsigned char *out, void *old,
+        void const *now, unsigned int width, unsigned char *guess) {
+    __m128i const unchanged = compareLanes(old, now, width == 2U);
+    
+    if (_mm_movemask_epi8(unchanged) == 0xFFFF) {
+        return out;
+        
+    }
+    
+    out = encodeLanes(out, old, now, unchanged, width, guess);
+    copyLanes(old, now, width);
+    return out;
+}
+
+// Append the former values of the blocks of an array of the shadow 
+// cast that differ from the cast, after a bit per block that tells 
+// which blocks changed. Given dirty bytes, the function only compares 
+// the blocks with a slot marked for the rewind buffer. It appends 
+// nothing if no block changed.
+static unsigned char *recordColumn(unsigned char *out, void *shadow,
+        void const *cast, unsigned char const *dirty, unsigned int lanes,
+        unsigned int width) {
+    __m128i const flag = _mm_set1_epi8((char) DIRTY_REWIND);
+    unsigned char *const map = out;
+    unsigned char guess = 0;
+    unsigned int bits = 0, changed = 0, i;
+    
+    out += REWIND_MAP_BYTES(lanes);
+    for (i = 0; i < lanes; i += ACTOR_LANES) {
+        unsigned int const block = i / ACTOR_LANES;
+        unsigned char *const start = out;
+        
+        if (dirty == NULL || _mm_movemask_epi8(_mm_cmpeq_epi8(
+                _mm_setzero_si128(), _mm_and_si128(flag, _mm_loadu_si128(
+                (__m128i const*)&dirty[i])))) != 0xFFFF) {
+            out = width == 2U
+                ? recordLanes(out, (unsigned char*)shadow + i*2U,
+                (unsigned char const*)cast + i*2U, 2U, &guess)
+                : recordLanes(out, (unsigned char*)shadow + i,
+                (unsigned char const*)cast + i, 1U, &guess);
+            bits |= (unsigned int) (out != start) << block%8U;
+            
+        }
+        
+        // A byte of the map is complete after eight blocks.
+        if (block%8U == 7U || i + ACTOR_LANES >= lanes) {
+            map[block/8U] = (unsigned char) bits;
+            changed |= bits;
+            bits = 0;
+            
+        }
+    }
+    
+    return changed != 0 ? out : map;
+}
+
+// Put the former values of the changed lanes of a block of an array 
+// back into the shadow cast.
+static unsigned char const *undoLanes(unsigned char const *in,
+        unsigned char *old, unsigned int width) {
+    unsigned int bits = (unsigned int) getInteger(in, 2);
+    unsigned int const way = in[2];
+    signed char const same = way == REWIND_SAME ? (signed char) in[3] : 0;
+    unsigned int lane, count, value;
+    
+    in += way == REWIND_SAME ? 4 : 3;
+    for (lane = 0, count = 0; bits >> lane != 0; ++lane) {
+        count += bits >> lane & 1U;
+    }
+    
+    for (lane = 0, value = 0; bits != 0; ++lane, bits >>= 1) {
+        signed char difference;
+        
+        if ((bits & 1U) == 0) {
+            continue;
+            
+        } else if (way == REWIND_WHOLE) {
+            old[lane*2U] = in[value];
+            old[lane*2U + 1U] = in[count + value++];
+            continue;
+            
+        }
+        
+        difference = way == REWIND_SAME ? same : (signed char) in[lane];
+        if (width == 2U) {
+            unsigned short *const wide = (unsigned short*) (void*) old;
+            
+            wide[lane] = (unsigned short) (wide[lane] + difference);
+            
+        } else {
+            old[lane] = (unsigned char) (old[lane] + difference);
+            
+        }
+    }
+    
+    return in + (way == REWIND_WHOLE ? 2U*count
+        : way == REWIND_SMALL ? ACTOR_LANES : 0U);
+}
+
+// Put the former values of the changed blocks of an array back into 
+// the shadow cast.
+static unsigned char const *undoColumn(unsigned char const *in,
+        void *shadow, unsigned int lanes, unsigned int width) {
+    unsigned char const *const map = in;
+    unsigned int i;
+    
+    in += REWIND_MAP_BYTES(lanes);
+    for (i = 0; i < lanes; i += ACTOR_LANES) {
+        if (((unsigned int) map[i/ACTOR_LANES/8U] >> i/ACTOR_LANES%8U & 1U)
+                != 0) {
+            in = undoLanes(in, (unsigned char*)shadow + i*width, width);
+            
+        }
+    }
+    
+    return in;
+}
+
+// Copy a slot of the shadow cast back into the cast. Generations 
+// follow the rules of the `restoreSlot` function. Copying a slot again 
+// changes nothing.
+static void undoSlot(sCast *c, sCast *sh, unsigned int slot) {
+    unsigned short generation = c->generation[slot];
+    
+    if (sh->generation[slot] != generation
+            || (sh->moldId[slot] == MOLD_NULL
+            && c->moldId[slot] != MOLD_NULL)) {
+        generation = (unsigned short) (generation + 1U);
+        
+    }
+    c->x[slot] = sh->x[slot];
+    c->y[slot] = sh->y[slot];
+    c->subX[slot] = sh->subX[slot];
+    c->older[slot] = sh->older[slot];
+    c->younger[slot] = sh->younger[slot];
+    c->nextFree[slot] = sh->nextFree[slot];
+    c->velY[slot] = sh->velY[slot];
+    c->moldId[slot] = sh->moldId[slot];
+    c->frame[slot] = sh->frame[slot];
+    c->health[slot] = sh->health[slot];
+    c->timer[slot] = sh->timer[slot];
+    c->generation[slot] = sh->generation[slot] = generation;
+    c->rest[slot] = 0x00;
+    markDirty(c, slot);
+    return;
+}
+
+// Copy the slots of the changed blocks of an array back into the cast.
+static unsigned char const *undoColumnSlots(unsigned char const *in,
+        sCast *c, sCast *sh, unsigned int lanes) {
+    unsigned char const *const map = in;
+    unsigned int i;
+    
+    in += REWIND_MAP_BYTES(lanes);
+    for (i = 0; i < lanes; i += ACTOR_LANES) {
+        unsigned int bits, way, lane, count;
+        
+        if (((unsigned int) map[i/ACTOR_LANES/8U] >> i/ACTOR_LANES%8U & 1U)
+                == 0) {
+            continue;
+            
+        }
+        
+        bits = (unsigned int) getInteger(in, 2);
+        way = in[2];
+        for (lane = i, count = 0; bits != 0; ++lane, bits >>= 1) {
+            if (bits & 1U) {
+                undoSlot(c, sh, lane);
+                ++count;
+                
+            }
+        }
+        in += way == REWIND_SAME ? 4U
+            : way == REWIND_SMALL ? 3U + ACTOR_LANES : 3U + 2U*count;
+    }
+    
+    return in;
+}
+
+static void saveRewindHead(sRewindTick *dst, sCast const *src) {
+    memcpy(dst->oldest, src->oldest, sizeof dst->oldest);
+    memcpy(dst->youngest, src->youngest, sizeof dst->youngest);
+    dst->freeSlot = src->freeSlot;
+    dst->deadSlot = src->deadSlot;
+    dst->deadTail = src->deadTail;
+    dst->slots = (unsigned short) src->slots;
+    dst->live = (unsigned short) src->live;
+    dst->tick = src->tick;
+    return;
+}
+
+static void loadRewindHead(sCast *dst, sRewindTick const *src) {
+    memcpy(dst->oldest, src->oldest, sizeof dst->oldest);
+    memcpy(dst->youngest, src->youngest, sizeof dst->youngest);
+    dst->freeSlot = src->freeSlot;
+    dst->deadSlot = src->deadSlot;
+    dst->deadTail = src->deadTail;
+    dst->slots = src->slots;
+    dst->live = src->live;
+    dst->tick = src->tick;
+    return;
+}
+
+int recordTick(sScene *s) {
+    sCast *c = &s->cast;
+    sRewind *r = &s->rewind;
+    sCast *sh = &r->shadow;
+    unsigned int const lanes = ROUND_TO_LANES(
+        c->slots > sh->slots ? c->slots : sh->slots);
+    unsigned int const need = 2U + REWIND_COLUMNS*(REWIND_MAP_BYTES(lanes)
+        + lanes / ACTOR_LANES * REWIND_BLOCK_BYTES);
+    void *shadow[REWIND_COLUMNS], *cast[REWIND_COLUMNS];
+    __m128i flags = _mm_setzero_si128();
+    sRewindTick *t;
+    unsigned char *start, *out;
+    unsigned int columnMask = 0, i, k;
+    int marked;
+    
+    if (r->ticks == NULL) {
+        return 1;
+        
+    }
+    
+    if (sh->capacity < c->slots && growCast(sh, c->capacity)) {
+        return 1;
+        
+    }
+    
+    // A tick that may not fit into the ring at all drops the whole 
+    // rewind buffer.
+    if (need > REWIND_BYTES) {
+        r->tickCount = 0;
+        copyCast(sh, c);
+        return 0;
+        
+    }
+    
+    // The bytes of a tick never wrap around the ring. Ticks past the 
+    // end of the latest tick are older than the ticks before it.
+    if (r->end + need > REWIND_BYTES) {
+        while (r->tickCount != 0
+                && r->ticks[r->firstTick % REWIND_TICKS].first >= r->end) {
+            ++r->firstTick;
+            --r->tickCount;
+        }
+        r->end = 0;
+        
+    }
+    while (r->tickCount == REWIND_TICKS || (r->tickCount != 0
+            && r->ticks[r->firstTick % REWIND_TICKS].first >= r->end
+            && r->ticks[r->firstTick % REWIND_TICKS].first
+            < r->end + need)) {
+        ++r->firstTick;
+        --r->tickCount;
+    }
+    
+    t = &r->ticks[(r->firstTick + r->tickCount++) % REWIND_TICKS];
+    t->first = r->end;
+    t->lanes = (unsigned short) lanes;
+    saveRewindHead(t, sh);
+    
+    // The arrays of the motion change on most ticks, and compare every 
+    // block. The other arrays only compare the blocks with a slot that 
+    // changed them, if any slot did. A shift brings the flag to the 
+    // most significant bit of each byte.
+    for (i = 0; i < lanes; i += ACTOR_LANES) {
+        flags = _mm_or_si128(flags,
+            _mm_loadu_si128((__m128i*)&c->dirty[i]));
+    }
+    marked = _mm_movemask_epi8(_mm_slli_epi16(flags, 5)) != 0;
+    
+    listColumns(sh, shadow);
+    listColumns(c, cast);
+    start = out = r->bytes + r->end;
+    out += 2;
+    for (k = 0; k < REWIND_COLUMNS; ++k) {
+        unsigned int const width = k < REWIND_WIDE_COLUMNS ? 2U : 1U;
+        unsigned char *const column = out;
+        
+        if (REWIND_MOTION_COLUMNS >> k & 1U) {
+            out = recordColumn(out, shadow[k], cast[k], NULL, lanes, width);
+            
+        } else if (marked) {
+            out = recordColumn(out, shadow[k], cast[k], c->dirty, lanes,
+                width);
+            
+        }
+        columnMask |= (unsigned int) (out != column) << k;
+    }
+    start[0] = (unsigned char) (columnMask & 0xFFU);
+    start[1] = (unsigned char) (columnMask >> 8);
+    
+    for (i = 0; marked && i < lanes; i += ACTOR_LANES) {
+        _mm_storeu_si128((__m128i*)&c->dirty[i], _mm_andnot_si128(
+            _mm_set1_epi8((char) DIRTY_REWIND),
+            _mm_loadu_si128((__m128i*)&c->dirty[i])));
+    }
+    copyCastHead(sh, c);
+    
+    t->last = r->end = (unsigned int) (out - r->bytes);
+    return 0;
+}
+
+int rewindTick(sScene *s) {
+    sCast *c = &s->cast;
+    sRewind *r = &s->rewind;
+    sCast *sh = &r->shadow;
+    void *shadow[REWIND_COLUMNS];
+    unsigned char const *first, *in;
+    sRewindTick const *t;
+    unsigned int columnMask, i, k;
+    
+    if (r->tickCount == 0) {
+        return 1;
+        
+    }
+    
+    // Discard the changes since the latest recorded tick first.
+    for (i = 0; i < c->slots || i < sh->slots; ++i) {
+        if (i >= sh->slots) {
+            
+            // Slots past the shadow cast can only hold actors that 
+            // spawned since.
+            if (c->moldId[i] != MOLD_NULL) {
+                c->moldId[i] = MOLD_NULL;
+                c->generation[i] = (unsigned short)
+                    (c->generation[i] + 1U);
+                markDirty(c, i);
+                
+            }
+            
+        } else if (c->x[i] != sh->x[i] || c->y[i] != sh->y[i]
+                || c->subX[i] != sh->subX[i] || c->velY[i] != sh->velY[i]
+                || c->moldId[i] != sh->moldId[i]
+                || c->frame[i] != sh->frame[i]
+                || c->health[i] != sh->health[i]
+                || c->timer[i] != sh->timer[i]
+                || c->generation[i] != sh->generation[i]
+                || c->older[i] != sh->older[i]
+                || c->younger[i] != sh->younger[i]
+                || c->nextFree[i] != sh->nextFree[i]) {
+            undoSlot(c, sh, i);
+            
+        }
+    }
+    
+    // The slots that the tick changed only go back into the cast once 
+    // every array of the shadow cast holds its former values.
+    t = &r->ticks[(r->firstTick + --r->tickCount) % REWIND_TICKS];
+    listColumns(sh, shadow);
+    first = r->bytes + t->first;
+    columnMask = (unsigned int) getInteger(first, 2);
+    for (k = 0, in = first + 2; k < REWIND_COLUMNS; ++k) {
+        if ((columnMask >> k & 1U) != 0) {
+            in = undoColumn(in, shadow[k], t->lanes,
+                k < REWIND_WIDE_COLUMNS ? 2U : 1U);
+            
+        }
+    }
+    for (k = 0, in = first + 2; k < REWIND_COLUMNS; ++k) {
+        if ((columnMask >> k & 1U) != 0) {
+            in = undoColumnSlots(in, c, sh, t->lanes);
+            
+        }
+    }
+    loadRewindHead(c, t);
+    loadRewindHead(sh, t);
+    
+    // The next tick takes the place of the tick that went away. Older 
+    // ticks past the end of the ring stay where they are.
+    r->end = t->first;
+    
+    hashSlots(c);
+    s->grid.stale = 1;
+    return 0;
+}
+
+void freeRewind(sRewind *r) {
+    freeCast(&r->shadow);
+    free(r->ticks);
+    free(r->bytes);
+    r->ticks = NULL;
+    r->bytes = NULL;
+    r->tickCount = 0;
     return;
 }
\ No newline at end of file
@@ -31,44 +31,290 @@ typedef struct {
 // multiples of four.
 #define SOLID_TILE_PERIOD 4
 typedef char TILE;
+
+// Each bit of a solidity word tells whether one tile is solid or not.
+typedef unsigned int SOLID_WORD;
 typedef struct {
     
-    // The game stores the level that it currently loaded as a 
-    // region of bytes. Each byte stores a identifying number that 
-    // expresses a tile. Each such identifier refers to a tile to 
-    // render. The game has the responsibility of loading the graphic 
-    // data for each tile. The region of bytes defines the tilemap 
-    // that mobs exist in. This region stores this tile data as 
-    // columns of level height. Furthermore, the region expresses 
-    // these tiles in increasing order of their height. That is, the 
-    // region stores a column of tiles in big-endian form. The least 
-    // significant address in a column of tiles references the lowest 
-    // tile.
-    TILE const *data;
+    // The game maps the file of the level that it currently loaded 
+    // into memory, or finds it in the archive, and reads the tiles 
+    // right from the file. Each tile takes a nibble, and each byte 
+    // stores two tiles, the high nibble first. Each nibble stores a 
+    // identifying number that expresses a tile. Each such identifier 
+    // refers to a tile to render. The game has the responsibility of 
+    // loading the graphic data for each tile. The tiles define the 
+    // tilemap that mobs exist in. The file stores this tile data as 
+    // columns of level height. Furthermore, the file expresses these 
+    // tiles in increasing order of their height. The first tile in a 
+    // column of tiles references the lowest tile. The `getTile` macro 
+    // reads one tile.
+    unsigned char const *tiles;
+    
+    // The collision checks only need to know whether a tile is solid 
+    // or not. The level also stores this information as a bitmap of 
+    // columns. Each column spans `solidStride` words. The least 
+    // significant bit of the first word of a column references the 
+    // lowest tile.
+    SOLID_WORD const *solid;
+    unsigned short solidStride;
+    
+    // Each row of tiles also has two tables of distances. For each 
+    // tile, the tables store the amount of tiles that are not solid 
+    // from this tile up to the next solid tile to the left or to the 
+    // right. The tables store a row of level width after another. 
+    // The largest value means that there is no solid tile up to the 
+    // end of the level.
+    unsigned short const *clearLeft, *clearRight;
     
     // The game stores the width and height of the level as amounts 
     // of pixels.
     unsigned short w, h;
     
     sCoord spawn;
+    
+    // The arrays above share one allocation, apart from the tiles of 
+    // version 1 files, which stay in the file. The `file` member holds 
+    // the mapping of the file, unless the file lies in the archive. 
+    // Levels that share the arrays of another level do not own this 
+    // allocation or mapping, and have a null block and a null file.
+    void *block;
+    void *file;
+    unsigned long fileBytes;
 } sLevel;
 
-#define MAX_ACTORS 256
+// Version 1 level files start with a header of four 12-bit fields, 
+// which hold the width, the height and the spawn of the player in 
+// tiles. The packed tiles follow. Version 2 level files start with a 
+// signature, then the same fields as 32-bit little-endian integers, 
+// followed by the amount of columns per chunk and the amount of 
+// chunks. An index of chunks follows the header. Each entry holds the 
+// position of a chunk from the start of the file, its amount of bytes 
+// and its encoding, as 32-bit little-endian integers. A chunk stores 
+// the tiles of its columns either packed, starting at a whole byte, 
+// or as runs. Each byte of a run holds the length of the run minus one 
+// in its high nibble and the tile in its low nibble. The signature 
+// starts with two zero bytes, which would be a level of zero columns 
+// in version 1.
+#define LEVEL_V2_SIGNATURE "\0\0LV"
+#define LEVEL_V2_HEADER_BYTES 28U
+#define LEVEL_V2_ENTRY_BYTES 12U
+#define LEVEL_RUN_TILES_MAX 16U
+enum {
+    LEVEL_CHUNK_PACKED,
+    LEVEL_CHUNK_RUNS
+};
+
+// Read the tile at a column and a row of a level. The first row is the 
+// lowest row. The shift picks the high nibble for even tiles and the 
+// low nibble for odd tiles without a branch. The macro evaluates its 
+// arguments more than once.
+#define TILE_INDEX(l, column, row) \
+    ((unsigned long) (column)*(l)->h + (unsigned long) (row))
+#define getTile(l, column, row) ((TILE) \
+    ((l)->tiles[TILE_INDEX(l, column, row)/2U] \
+    >> (~TILE_INDEX(l, column, row)%2U*4U) & 0x0F))
+
+// A cast holds at most this many actors, unless the level places more 
+// actors than that.
+#define ACTOR_LIMIT_DEFAULT 256U
+#define ACTOR_SLOTS_MAX 0xFFF0U
+#define ACTOR_SLOT_NONE 0xFFFFU
 #define GRAVITY 2
 #define MOLD_NULL 0xFF
+
+// A handle refers to one actor across kills and spawns. The sixteen 
+// least significant bits store the slot of the actor. The other bits 
+// store the generation of the slot at the time of spawning. Killing 
+// an actor bumps the generation of its slot, which invalidates all 
+// handles to the actor.
+typedef unsigned int ACTOR_HANDLE;
+#define ACTOR_HANDLE_NONE ~~((ACTOR_HANDLE) ACTOR_SLOT_NONE)
+
+// The player is always the first actor.
+#define ACTOR_PLAYER 0U
+
+// Actors do not change other actors while they update. They record 
+// these changes as commands instead, which the simulation applies in 
+// the order of the slots once all actors updated. A command keeps the 
+// slot and position of the actor that gave it.
 typedef struct {
-    struct {
-        union {
-            sActor player;
-            sActor actor[MAX_ACTORS];
-        } actorData;
-        unsigned short actors;
-    };
+    unsigned short slot, x, y;
+    unsigned char kind;
+    signed char direction;
+} sCommand;
+
+typedef struct {
+    
+    // The cast stores each attribute of all actors as its own array. 
+    // The attributes at the same slot describe one actor. The 
+    // simulation can then update the same attribute of many actors 
+    // at once. The `sActor` struct gathers the attributes of one 
+    // actor for logic that handles actors one at a time. The arrays 
+    // share one allocation of `capacity` slots, which grows on demand. 
+    // Slots keep their actor until it dies. Dead slots have the null 
+    // mold identifier.
+    unsigned short *x, *y;
+    signed short *subX;
+    signed char *velY;
+    unsigned char *moldId;
+    signed char *frame, *health;
+    unsigned char *timer;
+    unsigned short *generation;
+    
+    // The actors of each mold form a list from the oldest actor to 
+    // the youngest actor. Spawners recycle the oldest actors of a 
+    // mold when the cast is full.
+    unsigned short *older, *younger;
+    unsigned short oldest[MOLDS], youngest[MOLDS];
+    
+    // Slots of actors that died before the current tick are free to 
+    // reuse. Slots of actors that die during a tick only become free 
+    // on the next tick.
+    unsigned short *nextFree;
+    unsigned short freeSlot, deadSlot, deadTail;
+    
+    // Each byte tells whether the slot at the same index changed since 
+    // the latest checkpoint, since the latest update of its hash, and 
+    // since the latest tick of the rewind buffer.
+    unsigned char *dirty;
+    
+    // The hash of each slot, and the sum of these hashes. Dead slots 
+    // hash to zero. The simulation only hashes the slots that changed 
+    // again.
+    unsigned int *hashes;
+    unsigned long hash;
+    
+    // Each byte caches the collision checks of an actor that rests on 
+    // the ground and does not move. Such an actor is asleep, and skips 
+    // its collision checks as long as it stays at the same position. 
+    // Changing a slot through the `setActor` function wakes its actor 
+    // up.
+    unsigned char *rest;
+    
+    // The simulation uses these arrays as scratch space within a 
+    // tick. They have no meaning between ticks.
+    unsigned char *grounded;
+    signed short *maxSubX;
+    unsigned short *sorted, *found, *byMold;
+    sCommand *commands;
+    
+    // The simulation only looks at the slots before `slots`. There 
+    // are `live` actors among them.
+    unsigned int slots, live, capacity, limit;
+    
+    // The amount of ticks that the cast went through.
+    unsigned int tick;
 } sCast;
+
+// The grid sorts actors into buckets of pixel columns by the position 
+// of their left side. Queries over a range of columns then only look 
+// at the buckets that the range overlaps.
+#define GRID_BUCKET_PELS 128U
+#define GRID_BUCKETS ~~(0x10000U / GRID_BUCKET_PELS)
+typedef struct {
+    
+    // The slots of the actors in the bucket `i` are in 
+    // `sorted[first[i]]` up to `sorted[first[i+1]]` of the cast, in 
+    // increasing order.
+    unsigned short first[GRID_BUCKETS+1U];
+    
+    // Only the buckets that the level spans are in use. Actors past the 
+    // end of the level fall into the last bucket.
+    unsigned int buckets;
+    
+    // An actor can overlap buckets to the right of its own bucket. 
+    // Queries must look this far to the left of their range.
+    unsigned char maxW;
+    
+    // The grid sorted the cast at the tick `tick`. Loading a checkpoint 
+    // or rewinding marks the grid stale, since the cast then goes back 
+    // to earlier ticks.
+    unsigned int tick;
+    char stale;
+} sActorGrid;
+
+// A record keeps the state of one slot.
+typedef struct {
+    sActor actor;
+    unsigned short slot, generation, older, younger, nextFree;
+} sSlotRecord;
+
+#define CHECKPOINTS_MAX 8U
+typedef struct {
+    
+    // The base cast is a copy of the cast at the latest checkpoint. 
+    // Loading this checkpoint only copies the dirty slots of the cast 
+    // back from the base cast.
+    sCast base;
+    
+    // Every earlier checkpoint records the slots that changed before 
+    // the next checkpoint, as these slots were at the earlier 
+    // checkpoint. The records of the checkpoint `i` go from 
+    // `records[marks[i].first]` up to the records of the next 
+    // checkpoint. The head of a mark keeps the attributes of the whole 
+    // cast at the checkpoint. Its arrays are unused.
+    sSlotRecord *records;
+    unsigned int recordCount, recordCapacity;
+    struct {
+        unsigned int first;
+        sCast head;
+    } marks[CHECKPOINTS_MAX];
+    unsigned int count;
+} sCheckpoints;
+
+// The rewind buffer keeps the latest ticks of the cast in a ring of 
+// bytes. Each tick stores the attributes that changed during the tick 
+// as they were before it. A tick starts with a mask of the attribute 
+// arrays that changed. Each of these arrays then has a bit per block of 
+// lanes that tells whether the block changed. Each changed block has a 
+// mask of the lanes that changed, followed by their former values, 
+// mostly as differences from the current values. Recording drops the 
+// oldest ticks to make room.
+#define REWIND_TICKS 1024U
+#define REWIND_BYTES 0x40000U
+typedef struct {
+    
+    // The bytes of the tick go from `first` up to `last` in the ring.
+    unsigned int first, last;
+    unsigned short lanes;
+    unsigned short oldest[MOLDS], youngest[MOLDS];
+    unsigned short freeSlot, deadSlot, deadTail, slots, live;
+    unsigned int tick;
+} sRewindTick;
+typedef struct {
+    
+    // The shadow cast is a copy of the cast as of the latest recorded 
+    // tick.
+    sCast shadow;
+    sRewindTick *ticks;
+    unsigned char *bytes;
+    
+    // The ticks from `firstTick` on wrap around the array of ticks. 
+    // The next tick starts at the byte `end`.
+    unsigned int firstTick, tickCount, end;
+} sRewind;
+
+// Actors whose center lies farther than `radius` pixels from the center 
+// of the camera only run their behaviour once every `divisor` ticks. 
+// On the other ticks, they only fall, land and stop at walls. Actors 
+// take turns by slot, so that far actors spread over all ticks. The 
+// divisor must be a power of two. A divisor of one updates every actor 
+// on every tick.
+#define LOD_RADIUS_DEFAULT VIEWPORT_WIDTH
+#define LOD_DIVISOR_DEFAULT 4U
+typedef struct {
+    unsigned short radius;
+    unsigned char divisor;
+} sLod;
+
 typedef struct {
     sCast cast;
     sMoldDirectory md;
     sLevel level;
+    sLod lod;
+    sActorGrid grid;
+    sCheckpoints checkpoints;
+    sRewind rewind;
 } sScene;
 
 #define KEYS 7
@@ -83,12 +329,142 @@ typedef struct {
     sInput input;
 } sContext;
 
+// Each bit of a key set matches the member of the `sInput` struct at 
+// the same position.
+enum {
+    KEY_RIGHT = 1<<0,
+    KEY_UP = 1<<1,
+    KEY_LEFT = 1<<2,
+    KEY_DOWN = 1<<3,
+    KEY_RUN = 1<<4,
+    KEY_JUMP = 1<<5,
+    KEY_SLIDE = 1<<6
+};
+
+// Update the hold duration of each key of a key set the same way that 
+// the game samples the keyboard.
+void pressKeys(sInput *input, unsigned char keys);
+
 int initContext(sScene *s);
-int freeLevelData(void);
+
+// Set up a scene with the molds and the level of another scene, and a 
+// copy of its actors. Both scenes share the arrays of the level, so 
+// the source scene must outlive the new scene. The new scene does not 
+// record ticks for rewinding. The function returns non-zero on 
+// failure.
+int cloneContext(sScene *dst, sScene const *src);
+
+// Return the position of the left side of the camera in pixels. The 
+// camera follows the center of the player, and stops at the sides of 
+// the level.
+unsigned int getCameraLeft(sScene const *s);
+
+// A compiled spawn table starts with a signature, then the amount of 
+// entries and the checksum of the text form that it comes from, as 
+// 32-bit little-endian integers. The checksum is the one of the 
+// `hashAsset` function. Each entry then takes two 
+// 16-bit little-endian coordinates, the mold and the health of an 
+// actor, and two reserved bytes. A coordinate of `SPAWN_COORD_START` 
+// stands for the coordinate of the spawn of the level, and no level 
+// is wide or tall enough to reach it.
+#define SPAWN_SIGNATURE "MIRS"
+#define SPAWN_HEADER_BYTES 12U
+#define SPAWN_RECORD_BYTES 8U
+#define SPAWN_COORD_START 0xFFFFU
+
+// Parse the text form of a spawn list, made of entries such as 
+// `teki:1 xy: 3808 32 hp: 2;`, and call the `spawn` function for each 
+// entry in order. Actors without a position start at `defaultPos`. A 
+// non-zero return value from `spawn` aborts parsing. The function 
+// returns non-zero on failure.
+int parseSpawnText(char const *path, sCoord defaultPos,
+    int (*spawn)(sActor const *a, void *ctx), void *ctx);
+
+// Load a level file of either version. The game keeps the tiles of 
+// version 1 files in the mapping of the file, and decodes the chunks 
+// of version 2 files into memory. Levels must fit in the coordinates 
+// of actors. The function returns non-zero on failure.
+int loadLevel(sLevel *dst, char const *path);
+
+// The function returns non-zero if the level does not own any arrays.
+int freeLevel(sLevel *l);
+
+// Copy the actors of a cast into another cast, which grows if 
+// necessary. The destination cast must be zeroed before its first 
+// use. The function returns non-zero if growing fails.
+int copyCast(sCast *dst, sCast const *src);
+void freeCast(sCast *c);
+
+// Hash the live actors of a cast from scratch. Two casts with the same 
+// actors in the same slots have the same hash. The result must match 
+// the `hash` member of the cast, which the simulation updates on its 
+// own.
+unsigned long hashCast(sCast const *c);
+
+// Combine the hash of the cast with the inputs of the current tick.
+unsigned long hashContext(sContext const *c);
+
+// Add a checkpoint after the existing ones. Saving costs time in 
+// function of the amount of slots that changed since the latest 
+// checkpoint. The function returns non-zero if there is no room for 
+// another checkpoint.
+int saveCheckpoint(sScene *s);
+
+// Restore the cast as it was at a checkpoint and drop all later 
+// checkpoints. Loading costs time in function of the amount of slots 
+// that changed since that checkpoint. Handles to actors that died or 
+// spawned since the checkpoint become invalid.
+void loadCheckpoint(sScene *s, unsigned int checkpoint);
+void freeCheckpoints(sCheckpoints *cp);
+
+// Record the changes of the cast since the previous call as one tick 
+// of the rewind buffer. Recording costs time in function of the amount 
+// of slots, and takes bytes in function of the amount of blocks of 
+// lanes that changed. Attributes other than the motion of the actors 
+// only cost time in the blocks where they may have changed. The 
+// function returns non-zero if the shadow cast cannot grow anymore, or 
+// if the scene does not record ticks.
+int recordTick(sScene *s);
+
+// Undo the latest recorded tick, as well as any change since. The 
+// function returns non-zero if the rewind buffer is empty.
+int rewindTick(sScene *s);
+void freeRewind(sRewind *r);
+
+// Find the slot of the actor that a handle refers to. The function 
+// returns `ACTOR_SLOT_NONE` if the actor died.
+unsigned int findActorSlot(sCast const *c, ACTOR_HANDLE h);
+ACTOR_HANDLE getActorHandle(sCast const *c, unsigned int slot);
+
+#define MOLD_NAME_CHARS 8U
+
+// Parse the mold information file into the mold directory. The 
+// function calls the `loadMold` function, if any, once the parser 
+// knows the name and dimensions of a mold. A non-zero return value 
+// from this function aborts parsing. The caller is then responsible 
+// for reporting the error.
+MirageError loadMoldInfo(sMoldDirectory *dst,
+    int (*loadMold)(sMold *dst, unsigned char moldId,
+    char const (*name)[MOLD_NAME_CHARS], void *ctx), void *ctx);
+
+// Advance the simulation by one tick. The function updates the player 
+// first, then all other actors. Rendering must only read the 
+// resulting scene.
 void updateContext(sContext *c);
 
 sActor updatePlayer(sContext *c);
-int updateNpc(sScene *s, sActor *ref);
+
+// Find the slots of the actors that overlap the pixel columns from 
+// `x0` up to, but excluding, `x1` in increasing order. The function 
+// returns the amount of such actors, and points `slots` to them. The 
+// slots stay valid until the next update or query. The grid reflects 
+// the cast as of the first query since the latest update, checkpoint 
+// load or rewind, which sorts the actors again.
+unsigned int findActors(sScene *s, unsigned int x0, unsigned int x1,
+    unsigned short const **slots);
+
+void getActor(sCast const *c, unsigned int id, sActor *dst);
+void setActor(sCast *c, unsigned int id, sActor const *src);
 
 #define _HEADER_LOGIC
 #endif
\ No newline at end of file
@@ -7,6 +7,8 @@
 #include "global_dict.h"
 #include "init.h"
 #include "logic.h"
+#include "inputlog.h"
+#include "archive.h"
 
 #define VIEWPORT_FPS 60
 
@@ -24,10 +26,11 @@ typedef struct {
 // Note that the debug menu only displays some performance metrics 
 // while ignoring others. An example of the latter is the 
 // `globalTimerResMs` member. Additionally, this file's code assumes 
-// that the `fps` member is the first member.
+// that the `fps` member is the first member. The state hash folds the 
+// hash of the latest tick into 16 bits.
 static struct {
     unsigned short fps, cpuPermille, handles, pagefileKi, ramKi, 
-        curTimerResMs, peakTimerResMs, globalTimerResMs;
+        curTimerResMs, peakTimerResMs, stateHash, globalTimerResMs;
 } perfStats;
 
 static sClock constuctClock(void);
@@ -45,12 +48,21 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd, unsigned int msg, WPARAM wParam,
 int main(void) {
     sClock clock = constuctClock();
     sContext game;
+    sInputLog log;
     HANDLE hproc;
     HWND hwnd;
     unsigned long long prevCpuHundredNs;
+    unsigned long hash = 0, stateHash;
     MirageError code;
     unsigned short prevCpuPermille, peakTimerResMs, processors;
     
+    // The input log starts empty and grows with each tick.
+    ZeroMemory(&log, sizeof log);
+    
+    // Every loader reads its file from the archive if there is one, and 
+    // from the file itself otherwise.
+    openArchive(DIR_ARCHIVE);
+    
     // The game loop will end immediately if this function call fails.
     // The window procedure is responsible for allocating and 
     // formating any data graphical data. Mold data incorporates 
@@ -320,15 +332,34 @@ int main(void) {
             
         }
         
-        // Update the player outside the window procedure. No decision 
-        // in this function call shall affect the player. Non-playable 
-        // characters do behave in function of whether they are 
-        // on-screen or not. As such, the paint handler in the window 
-        // procedure updates the non-playable characters.
-        game.scene.cast.actorData.player = updatePlayer(&game);
+        // Advance the simulation by one tick outside the window 
+        // procedure. All actors update regardless of whether the 
+        // window repaints or not. Holding the backspace key rewinds 
+        // the recorded ticks instead. The game carries on without 
+        // recording if memory runs out. The input log follows the 
+        // same ticks so that a replay ends in the same state.
+        if (GetFocus() == hwnd && GetAsyncKeyState(VK_BACK)) {
+            if (!rewindTick(&game.scene)) {
+                unlogInput(&log);
+                
+            }
+            
+        } else {
+            logInput(&log, &game.input);
+            updateContext(&game);
+            recordTick(&game.scene);
+            
+        }
+        
+        // The cast keeps its hash up to date on its own. The debug 
+        // interface also shows the inputs of the tick in the hash.
+        hash = game.scene.cast.hash;
+        stateHash = hashContext(&game);
+        perfStats.stateHash = (unsigned short)
+            ((stateHash ^ stateHash >> 16) & 0xFFFFU);
         
-        // The windows painting procedure is responsible for updating 
-        // the state of the game.
+        // The windows painting procedure only renders the resulting 
+        // state of the game.
         RedrawWindow(hwnd, NULL, NULL, RDW_INVALIDATE|RDW_UPDATENOW);
         
         clock.loops++;
@@ -345,6 +376,15 @@ int main(void) {
     // modification failures.
     timeEndPeriod(clock.c.minTimerResMs);
     
+    // The window procedure already released the actors, so the log 
+    // keeps the hash of the last tick instead.
+    if (log.ticks != 0) {
+        saveInputLog(&log, DIR_INPUT_LOG, hash);
+        
+    }
+    freeInputLog(&log);
+    closeArchive();
+    
     // The operating system automatically unregisters the process'
     // window class after termination.
     return code;
@@ -357,7 +397,7 @@ int main(void) {
 #define DEBUG_WIDTH_PELS ~~(VIEWPORT_WIDTH/2)
 #define DEBUG_HEIGHT_PELS ~~(5*VIEWPORT_HEIGHT/12)
 #define FONT_DEBUG_HEIGHT_PELS ~~(DEBUG_HEIGHT_PELS/METRICS)
-#define METRICS 9U  // Including two for the player's x and y.
+#define METRICS 10U  // Including the state hash and the player's x and y.
 
 LRESULT CALLBACK WindowProcedure(HWND hwnd,
         unsigned int message,
@@ -390,7 +430,7 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd,
         } display;
     } metric = {
         { {0, "  "}, {0, "%o"}, {0, "  "}, {0, "ki"}, {0, "ki"}, {0, "ms"},
-        {0, "ms"}, {0, "  "}, {0, "  "} }, DEBUG_OFF
+        {0, "ms"}, {0, "  "}, {0, "  "}, {0, "  "} }, DEBUG_OFF
     };
     
     switch (message) {
@@ -427,6 +467,7 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd,
                 "RAM Usage:\n"
                 "Current Timer Resolution:\n"
                 "Peak Timer Resoltion:\n"
+                "State Hash:\n"
                 "X:\n"
                 "Y:\n";
             char const fontDebug[] = "Courier New";
@@ -713,6 +754,10 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd,
             s = (sScene*) GetWindowLongPtr(hwnd, 0);
             if (s != NULL) {
                 sMoldDirectory *md = &s->md;
+                
+                freeCast(&s->cast);
+                freeCheckpoints(&s->checkpoints);
+                freeRewind(&s->rewind);
                 for (i = 0; i < md->molds; ++i) {
                     if (!DeleteObject(md->data[i].s.color)
                             || !DeleteObject(md->data[i].s.maskRight)
@@ -732,7 +777,7 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd,
                     || DeleteObject(debug.hf) == 0
                     || UnregisterHotKey(hwnd, MIRAGE_HOTKEY_TOGGLE) == 0
                     || UnregisterHotKey(hwnd, MIRAGE_HOTKEY_TERMINATE) == 0
-                    || freeLevelData()) {
+                    || freeLevel(&s->level)) {
                 code = MIRAGE_INVALID_FREE;
                 
             }
@@ -747,8 +792,9 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd,
             RECT wRect;
             HDC spriteMemDc;
             sScene *s;
-            unsigned int i, pelsBeforePlayersLeft;
+            unsigned int i, pelsBeforePlayersLeft, visible;
             unsigned char prevMoldId;
+            unsigned short const *visibleSlots;
             
             hdc = BeginPaint(hwnd, ps);
             
@@ -767,25 +813,7 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd,
                 
             }
             
-            pelsBeforePlayersLeft = (unsigned int)
-                ((s->cast.actorData.player.pos.x
-                + s->md.data[s->cast.actorData.player.moldId].w/2));
-            if (pelsBeforePlayersLeft < VIEWPORT_WIDTH/2) {
-                pelsBeforePlayersLeft = 0;
-                
-            } else if (pelsBeforePlayersLeft
-                    + VIEWPORT_WIDTH/2 >= TILE_PELS*s->level.w) {
-                pelsBeforePlayersLeft = (unsigned int)(TILE_PELS*s->level.w
-                    - VIEWPORT_WIDTH);
-                
-            } else {
-                // XXX: Consider case of being at the right-most 
-                // boundary of the level.
-                
-                pelsBeforePlayersLeft = (unsigned int)
-                    (pelsBeforePlayersLeft - VIEWPORT_WIDTH/2);
-                
-            }
+            pelsBeforePlayersLeft = getCameraLeft(s);
             
             // Display all tiles visible in the viewport. This 
             // rendering process also includes the right-most column 
@@ -800,9 +828,8 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd,
                 unsigned int j;
                 
                 for (j = 0; j < VIEWPORT_HEIGHT/TILE_PELS; ++j) {
-                    TILE const t = s->level.data[j 
-                        + (pelsBeforePlayersLeft/TILE_PELS+i)
-                        *s->level.h];
+                    TILE const t = getTile(&s->level,
+                        pelsBeforePlayersLeft/TILE_PELS + i, j);
                     sCoord const tScreen = {
                         (unsigned short)(TILE_PELS*i),
                         (unsigned short)(VIEWPORT_HEIGHT - TILE_PELS*j 
@@ -829,10 +856,15 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd,
                 
             }
             
-            // Display all sprites that can appear in the viewport.
+            // Display all sprites that can appear in the viewport. The 
+            // grid of actors only yields these sprites.
+            visible = findActors(s, pelsBeforePlayersLeft,
+                pelsBeforePlayersLeft+VIEWPORT_WIDTH, &visibleSlots);
             spriteMemDc = CreateCompatibleDC(backbuffer.memoryDc);
-            for (i = 0, prevMoldId = MOLD_NULL; i < s->cast.actors; ++i) {
-                sActor actor = s->cast.actorData.actor[i];
+            for (i = 0, prevMoldId = MOLD_NULL; i < visible; ++i) {
+                sActor actor;
+                
+                getActor(&s->cast, visibleSlots[i], &actor);
                 
                 // A mold identifier equal to zero outside the mold 
                 // directory identifies a null actor.
@@ -842,27 +874,6 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd,
                     POINT para[3];
                     unsigned char frameIndex;
                     
-                    if ((unsigned int)(actor.pos.x+mold.w-1) 
-                            < pelsBeforePlayersLeft
-                            || actor.pos.x 
-                            >= pelsBeforePlayersLeft+VIEWPORT_WIDTH) {
-                        continue;
-                        
-                    }
-                    
-                    // Do not update the player again.
-                    if (&s->cast.actorData.player 
-                            - &s->cast.actorData.actor[0] != i) {
-                        
-                        // Update the logic of the actor. Skip the 
-                        // rest of the logic if the actor died.
-                        if (updateNpc(s, &s->cast.actorData.actor[i])) {
-                            continue;
-                            
-                        }
-                        
-                    }
-                    
                     if (actor.moldId != prevMoldId) {
                         // Ignore the return value as what the device 
                         // context previously selected is not 
@@ -931,11 +942,10 @@ LRESULT CALLBACK WindowProcedure(HWND hwnd,
                 unsigned short metricData[METRICS];
                 memcpy(&metricData, &perfStats, sizeof perfStats);
                 
-                // Assume that the horizontal position is at a lower 
-                // address then the vertical position.
-                memcpy(metricData + METRICS - 2, // X and Y coordinates
-                    &s->cast.actorData.player.pos, 
-                    sizeof s->cast.actorData.player.pos);
+                // The last two metrics are the X and Y coordinates. They 
+                // take the place of the members after the state hash.
+                metricData[METRICS - 2] = s->cast.x[ACTOR_PLAYER];
+                metricData[METRICS - 1] = s->cast.y[ACTOR_PLAYER];
             
                 // Update the metrics in the debug menu for the 
                 // current frame. This process is inefficient, 
@@ -0,0 +1,99 @@
+// The game and the headless programs share this module. It wraps the 
+// file mapping functions of Windows and the `mmap` function of other 
+// platforms.
+#ifdef _WIN32
+#include <WinDef.h>
+#include <fileapi.h>
+#include <handleapi.h>
+#include <memoryapi.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <stddef.h>
+
+#include "mapping.h"
+
+// Files past this size do not fit in the size of a mapping, since 
+// the `long` type takes four bytes on Windows.
+#define MAPPING_BYTES_MAX 0xFFFFFFFFUL
+
+void *mapFile(char const *path, unsigned long *size) {
+#ifdef _WIN32
+    HANDLE file, mapping;
+    LARGE_INTEGER bytes;
+    void *view;
+    
+    file = CreateFile(path,
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL);
+    if (file == INVALID_HANDLE_VALUE) {
+        return NULL;
+        
+    }
+    
+    // Empty files cannot be mapped.
+    if (!GetFileSizeEx(file, &bytes) || bytes.QuadPart <= 0
+            || (unsigned long long) bytes.QuadPart > MAPPING_BYTES_MAX) {
+        CloseHandle(file);
+        return NULL;
+        
+    }
+    
+    // The view keeps the mapping and the file open until it goes away.
+    mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (mapping == NULL) {
+        return NULL;
+        
+    }
+    
+    view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    *size = (unsigned long) bytes.QuadPart;
+    return view;
+#else
+    struct stat st;
+    void *view;
+    int const fd = open(path, O_RDONLY);
+    
+    if (fd < 0) {
+        return NULL;
+        
+    }
+    
+    if (fstat(fd, &st) != 0 || st.st_size <= 0
+            || (unsigned long long) st.st_size > MAPPING_BYTES_MAX) {
+        close(fd);
+        return NULL;
+        
+    }
+    
+    // The mapping stays valid after closing the file.
+    view = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        return NULL;
+        
+    }
+    
+    *size = (unsigned long) st.st_size;
+    return view;
+#endif
+}
+
+void unmapFile(void *view, unsigned long size) {
+#ifdef _WIN32
+    (void) size;
+    UnmapViewOfFile(view);
+#else
+    munmap(view, (size_t) size);
+#endif
+    return;
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef _HEADER_MAPPING
+
+// Map a whole file into memory for reading, and store the amount of 
+// bytes of the file in `size`. The memory is read-only. The function 
+// returns a null pointer on failure, or if the file is empty.
+void *mapFile(char const *path, unsigned long *size);
+void unmapFile(void *view, unsigned long size);
+
+#define _HEADER_MAPPING
+#endif
\ No newline at end of file
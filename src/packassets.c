@@ -0,0 +1,128 @@
+// Offline packer of asset archives. This program bundles the files 
+// that it receives into one archive, in the order of its arguments. 
+// The paths of the files must be relative to the working directory of 
+// the game, such as `user/Abe/tuto.lvl`. The program then opens the 
+// archive like the game does, and checks that it holds every file.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "archive.h"
+#include "mapping.h"
+
+
+int main(int argc, char **argv) {
+    unsigned char header[ARCHIVE_HEADER_BYTES], entry[ARCHIVE_ENTRY_BYTES];
+    unsigned long const count = argc > 2 ? (unsigned long) argc - 2U : 0;
+    unsigned long offset, i;
+    FILE *f;
+    int failed = 0;
+    
+    if (count == 0) {
+        fprintf(stderr, "usage: %s output file...\n", argv[0]);
+        return 1;
+        
+    }
+    
+    f = fopen(argv[1], "wb");
+    if (f == NULL) {
+        fprintf(stderr, "Could not write the archive %s.\n", argv[1]);
+        return 1;
+        
+    }
+    
+    // The files follow the table of contents in the same order.
+    memcpy(header, ARCHIVE_SIGNATURE, 4);
+    putInteger(header + 4, count, 4);
+    failed = fwrite(header, sizeof header, 1, f) != 1;
+    offset = ARCHIVE_HEADER_BYTES + count*ARCHIVE_ENTRY_BYTES;
+    for (i = 0; i < count && !failed; ++i) {
+        char const *path = argv[i + 2U];
+        size_t const length = strlen(path);
+        unsigned long bytes;
+        void *view;
+        unsigned int c;
+        
+        if (length >= ARCHIVE_NAME_BYTES) {
+            fprintf(stderr, "The path %s is too long.\n", path);
+            failed = 1;
+            break;
+            
+        }
+        
+        view = mapFile(path, &bytes);
+        if (view == NULL) {
+            fprintf(stderr, "Could not read the file %s.\n", path);
+            failed = 1;
+            break;
+            
+        }
+        
+        memset(entry, 0x00, sizeof entry);
+        for (c = 0; c < length; ++c) {
+            entry[c] = (unsigned char) (path[c] == '\\' ? '/' : path[c]);
+        }
+        putInteger(entry + ARCHIVE_NAME_BYTES, offset, 4);
+        putInteger(entry + ARCHIVE_NAME_BYTES + 4U, bytes, 4);
+        putInteger(entry + ARCHIVE_NAME_BYTES + 8U,
+            hashAsset(view, bytes), 4);
+        unmapFile(view, bytes);
+        failed = fwrite(entry, sizeof entry, 1, f) != 1;
+        offset += bytes;
+    }
+    
+    for (i = 0; i < count && !failed; ++i) {
+        unsigned long bytes;
+        void *view = mapFile(argv[i + 2U], &bytes);
+        
+        failed = view == NULL || fwrite(view, bytes, 1, f) != 1;
+        if (view != NULL) {
+            unmapFile(view, bytes);
+            
+        }
+    }
+    
+    failed = fclose(f) != 0 || failed;
+    if (failed) {
+        fprintf(stderr, "Could not write the archive %s.\n", argv[1]);
+        return 1;
+        
+    }
+    
+    if (openArchive(argv[1])) {
+        fprintf(stderr, "The archive %s is invalid.\n", argv[1]);
+        return 1;
+        
+    }
+    
+    // Assets that the archive lacks would come from their own files, 
+    // which have no view to release when they come from the archive.
+    for (i = 0; i < count && !failed; ++i) {
+        sAsset a;
+        unsigned long bytes;
+        void *view = mapFile(argv[i + 2U], &bytes);
+        
+        a.view = NULL;
+        failed = view == NULL || openAsset(&a, argv[i + 2U])
+            || a.view != NULL || a.size != bytes
+            || memcmp(a.bytes, view, bytes) != 0;
+        closeAsset(&a);
+        if (view != NULL) {
+            unmapFile(view, bytes);
+            
+        }
+        if (failed) {
+            fprintf(stderr, "The archive %s does not match the file %s.\n",
+                argv[1], argv[i + 2U]);
+            
+        }
+    }
+    
+    closeArchive();
+    if (!failed) {
+        printf("%s: %lu files, %lu bytes\n", argv[1], count, offset);
+        
+    }
+    
+    return failed;
+}
\ No newline at end of file
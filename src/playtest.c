@@ -0,0 +1,123 @@
+// Headless playtest driver. This program steps many games at once 
+// through an environment, each with its own stream of random inputs, 
+// and reports the throughput of the environment. The inputs only 
+// depend on the index of the game, such that runs are reproducible.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "global_dict.h"
+#include "logic.h"
+#include "env.h"
+#include "archive.h"
+#include "timing.h"
+
+#define PLAYTEST_DEFAULT_GAMES 256UL
+#define PLAYTEST_DEFAULT_TICKS 1000UL
+
+// Each game holds a random key set for this many ticks.
+#define PLAYTEST_HOLD_TICKS 30U
+
+int main(int argc, char **argv) {
+    static sEnv env;
+    unsigned char *keys;
+    unsigned long *seeds;
+    sObservation *obs;
+    sObservation initial, reset;
+    unsigned long games, ticks, tick, hash, sumX, nearby;
+    unsigned long long start, elapsedNs;
+    unsigned int i, maxX;
+    
+    games = argc > 1 ? strtoul(argv[1], NULL, 10) : PLAYTEST_DEFAULT_GAMES;
+    ticks = argc > 2 ? strtoul(argv[2], NULL, 10) : PLAYTEST_DEFAULT_TICKS;
+    if (games == 0 || games > 0xFFFFUL || ticks == 0) {
+        fprintf(stderr, "usage: %s [games] [ticks]\n", argv[0]);
+        return 1;
+        
+    }
+    
+    memset(&env, 0x00, sizeof env);
+    openArchive(DIR_ARCHIVE);
+    keys = malloc(games * sizeof*keys);
+    seeds = malloc(games * sizeof*seeds);
+    obs = malloc(games * sizeof*obs);
+    if (keys == NULL || seeds == NULL || obs == NULL
+            || initEnv(&env, (unsigned int) games)) {
+        fprintf(stderr, "Could not set up the games.\n");
+        free(keys);
+        free(seeds);
+        free(obs);
+        return 1;
+        
+    }
+    
+    for (i = 0; i < games; ++i) {
+        seeds[i] = i + 1UL;
+    }
+    
+    // Observations are compared whole, padding included.
+    memset(&initial, 0x00, sizeof initial);
+    memset(&reset, 0x00, sizeof reset);
+    observeEnv(&env, 0, &initial);
+    
+    start = getNs();
+    for (tick = 0; tick < ticks; ++tick) {
+        if (tick % PLAYTEST_HOLD_TICKS == 0) {
+            for (i = 0; i < games; ++i) {
+                seeds[i] = (seeds[i] * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+                keys[i] = (unsigned char) (seeds[i] >> 16 & 0x7FU);
+            }
+            
+        }
+        stepEnv(&env, 0, (unsigned int) games, keys, obs);
+    }
+    elapsedNs = getElapsedNs(start);
+    
+    for (i = 0, hash = 0, sumX = 0, nearby = 0, maxX = 0; i < games; ++i) {
+        hash = (hash + env.games[i].scene.cast.hash) & 0xFFFFFFFFUL;
+        sumX += obs[i].player.pos.x;
+        nearby += obs[i].nearbyCount;
+        if (obs[i].player.pos.x > maxX) {
+            maxX = obs[i].player.pos.x;
+            
+        }
+    }
+    
+    // A game that went back to its initial state must look like a game 
+    // that never left it, and find every live actor of the level.
+    for (i = 0; i < games; ++i) {
+        sScene *s = &env.games[i].scene;
+        unsigned short const *slots;
+        
+        resetEnv(&env, i);
+        observeEnv(&env, i, &reset);
+        if (memcmp(&reset, &initial, sizeof reset) != 0
+                || findActors(s, 0, 0x10000U, &slots) != s->cast.live) {
+            fprintf(stderr, "Game %u differs from a new game after a reset.\n",
+                i);
+            freeEnv(&env);
+            closeArchive();
+            free(keys);
+            free(seeds);
+            free(obs);
+            return 1;
+            
+        }
+    }
+    
+    printf("%7s %8s %10s %12s %9s %7s %7s %7s %10s\n", "games", "ticks",
+        "ms", "steps/s", "ns/step", "mean x", "max x", "nearby", "hash");
+    printf("%7lu %8lu %10.2f %12.0f %9.1f %7lu %7u %7.2f   %08lx\n", games,
+        ticks, (double) elapsedNs / 1e6,
+        (double) games * (double) ticks * 1e9 / (double) elapsedNs,
+        (double) elapsedNs / ((double) games * (double) ticks),
+        sumX / games, maxX, (double) nearby / (double) games, hash);
+    
+    freeEnv(&env);
+    closeArchive();
+    free(keys);
+    free(seeds);
+    free(obs);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+// Headless replay of an input log. This program loads the initial 
+// stage, feeds each recorded tick of inputs to the logic as fast as 
+// possible, and compares the hash of the resulting cast with the hash 
+// that the game stored in the log. The incremental hash of the cast 
+// must also match a hash of the whole cast.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "global.h"
+#include "global_dict.h"
+#include "logic.h"
+#include "inputlog.h"
+#include "archive.h"
+#include "timing.h"
+
+int main(int argc, char **argv) {
+    static sContext game;
+    sInputLog log;
+    char const *path = argc > 1 ? argv[1] : DIR_INPUT_LOG;
+    unsigned long long start, elapsedNs;
+    unsigned long recorded, replayed, whole;
+    unsigned int i, tick;
+    
+    memset(&log, 0x00, sizeof log);
+    if (loadInputLog(&log, path, &recorded)) {
+        fprintf(stderr, "Could not load the input log %s.\n", path);
+        freeInputLog(&log);
+        return 1;
+        
+    }
+    
+    memset(&game, 0x00, sizeof game);
+    openArchive(DIR_ARCHIVE);
+    if (loadMoldInfo(&game.scene.md, NULL, NULL) != MIRAGE_OK) {
+        fprintf(stderr, "Could not load the mold information.\n");
+        freeInputLog(&log);
+        return 1;
+        
+    }
+    
+    if (initContext(&game.scene)) {
+        fprintf(stderr, "Could not load the initial stage.\n");
+        freeInputLog(&log);
+        return 1;
+        
+    }
+    
+    start = getNs();
+    for (i = 0; i < log.count; ++i) {
+        for (tick = 0; tick < log.runs[i].ticks; ++tick) {
+            getRunInput(&log.runs[i], tick, &game.input);
+            updateContext(&game);
+        }
+    }
+    elapsedNs = getElapsedNs(start);
+    replayed = game.scene.cast.hash;
+    whole = hashCast(&game.scene.cast);
+    
+    printf("%10s %10s %12s %9s %7s %7s %10s %10s\n", "ticks", "ms",
+        "ticks/s", "ns/tick", "actors", "x", "hash", "expected");
+    printf("%10lu %10.2f %12.0f %9.1f %7u %7u   %08lx   %08lx\n",
+        log.ticks, (double) elapsedNs / 1e6,
+        (double) log.ticks * 1e9 / (double) elapsedNs,
+        (double) elapsedNs / (double) (log.ticks ? log.ticks : 1UL),
+        game.scene.cast.live,
+        (unsigned int) game.scene.cast.x[ACTOR_PLAYER],
+        replayed, recorded);
+    
+    freeInputLog(&log);
+    freeCheckpoints(&game.scene.checkpoints);
+    freeRewind(&game.scene.rewind);
+    freeCast(&game.scene.cast);
+    freeLevel(&game.scene.level);
+    closeArchive();
+    
+    if (replayed != whole) {
+        fprintf(stderr, "The incremental hash diverged from the hash of "
+            "the whole cast.\n");
+        return 1;
+        
+    }
+    
+    if (replayed != recorded) {
+        fprintf(stderr, "The replay diverged from the recording.\n");
+        return 1;
+        
+    }
+    return 0;
+}
\ No newline at end of file
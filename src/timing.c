@@ -0,0 +1,38 @@
+// The headless programs share this module to time their runs. It wraps 
+// the performance counter of Windows and the `clock_gettime` function 
+// of other platforms.
+#ifdef _WIN32
+#include <WinDef.h>
+#include <winbase.h>
+#else
+#include <time.h>
+#endif
+
+#include "timing.h"
+
+unsigned long long getNs(void) {
+#ifdef _WIN32
+    LARGE_INTEGER li, freq;
+    
+    // The `QueryPerformanceFrequency` function can never fail on 
+    // Windows XP and later.
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&li);
+    return (unsigned long long) li.QuadPart / (unsigned long long)
+        freq.QuadPart * 1000000000ULL
+        + (unsigned long long) li.QuadPart % (unsigned long long)
+        freq.QuadPart * 1000000000ULL / (unsigned long long) freq.QuadPart;
+#else
+    struct timespec ts;
+    
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long) ts.tv_sec * 1000000000ULL
+        + (unsigned long long) ts.tv_nsec;
+#endif
+}
+
+unsigned long long getElapsedNs(unsigned long long start) {
+    unsigned long long const elapsed = getNs() - start;
+    
+    return elapsed != 0 ? elapsed : 1ULL;
+}
\ No newline at end of file
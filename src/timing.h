@@ -0,0 +1,13 @@
+#ifndef _HEADER_TIMING
+
+// Read a monotonic clock in nanoseconds. Only the difference between 
+// two readings has a meaning.
+unsigned long long getNs(void);
+
+// Return the nanoseconds since a reading of the `getNs` function. The 
+// result is never zero, so that callers can divide by it even when the 
+// clock is too coarse to see any time go by.
+unsigned long long getElapsedNs(unsigned long long start);
+
+#define _HEADER_TIMING
+#endif
\ No newline at end of file